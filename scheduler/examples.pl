@@ -2,12 +2,26 @@
 
 # EECS678
 # Adopted from CS 241 @ The University of Illinois
+#
+# Any arguments are passed on to the simulator, e.g. ./examples.pl -e
+# With -q there is no timing diagram, so only the averages are compared.
+# With --trace each job file is first converted by csv2trace and the
+# simulator is run on the binary trace instead.
+
+$trace = grep { $_ eq '--trace' } @ARGV;
+$flags = join(' ', grep { $_ ne '--trace' } @ARGV);
+$lines = ($flags =~ /-q/) ? 3 : 8;
 
 for $file (<examples/*>){
 	if( $file =~ /proc(\d+)-c(\d+)-(\w+)\.out/){
 	#	print "Proc $1 CORE $2 Proc $3\n";
-		`./simulator -c $2 -s $3 examples/proc$1.csv | tail -8 > output1`;
-		`tail -8 $file > output2`;
+		$input = "examples/proc$1.csv";
+		if($trace){
+			`./csv2trace -d $input output.trace`;
+			$input = "output.trace";
+		}
+		`./simulator $flags -c $2 -s $3 $input | tail -$lines > output1`;
+		`tail -$lines $file > output2`;
 		$diff = `diff output1 output2`;
 		if($diff){
 			print "Test file $file differs\n$diff";
@@ -15,4 +29,4 @@ for $file (<examples/*>){
 	}
 }
 #cleanup
-`rm output1 output2`;
+`rm -f output1 output2 output.trace`;
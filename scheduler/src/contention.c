@@ -0,0 +1,199 @@
+/** @file contention.c
+ *
+ * Measures how the thread-safe build of libpriqueue and libscheduler holds
+ * up as more threads share one queue or one scheduler.  For 1, 2, 4, ...
+ * threads it times two workloads:
+ *
+ *   queue      every thread offers a random key to one shared keyed queue
+ *              and polls the head back out
+ *   scheduler  every thread submits SJF jobs to one shared scheduler and,
+ *              whenever a job lands on a core, finishes the jobs that core
+ *              runs until it goes idle
+ *
+ * and checks that the scheduler finished every job it was given.  This is
+ * built with PRIQUEUE_CONCURRENT and SCHEDULER_CONCURRENT whatever the rest
+ * of the tree is built with.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "libpriqueue/libpriqueue.h"
+#include "libscheduler/libscheduler.h"
+
+
+#define QUEUE_PREFILL 1024
+
+typedef struct _contention_t
+{
+	int operations;  // per thread
+
+	priqueue_t queue;
+
+	scheduler_t *scheduler;
+	atomic_int next_job, clock, finished;
+} contention_t;
+
+typedef struct _contention_thread_t
+{
+	contention_t *shared;
+	unsigned int seed;
+} contention_thread_t;
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-t <max threads>] [-n <operations>] [-c <cores>]\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -t  run with 1, 2, 4, ... up to this many threads (default: 64)\n");
+	fprintf(stderr, "  -n  operations per thread for each run (default: 200000)\n");
+	fprintf(stderr, "  -c  cores of the shared scheduler (default: 4)\n");
+}
+
+double elapsed_seconds(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+void *queue_worker(void *arg)
+{
+	contention_thread_t *thread = arg;
+	contention_t *shared = thread->shared;
+	int i;
+
+	for (i = 0; i < shared->operations; i++)
+	{
+		priqueue_offer_key(&shared->queue, shared, rand_r(&thread->seed));
+		priqueue_poll(&shared->queue);
+	}
+
+	return NULL;
+}
+
+void *scheduler_worker(void *arg)
+{
+	contention_thread_t *thread = arg;
+	contention_t *shared = thread->shared;
+	int i;
+
+	for (i = 0; i < shared->operations; i++)
+	{
+		int job_id = atomic_fetch_add(&shared->next_job, 1);
+		int core_id = scheduler_new_job_r(shared->scheduler, job_id, atomic_fetch_add(&shared->clock, 1),
+		                                  1 + rand_r(&thread->seed) % 16, 0);
+
+		// SJF never preempts, so the core is ours until it runs out of jobs.
+		while (core_id != -1 && job_id != -1)
+		{
+			job_id = scheduler_job_finished_r(shared->scheduler, core_id, job_id, atomic_fetch_add(&shared->clock, 1));
+			atomic_fetch_add(&shared->finished, 1);
+		}
+	}
+
+	return NULL;
+}
+
+// Run worker on threads threads and return the seconds it took.
+double run_threads(contention_t *shared, int threads, void *(*worker)(void *))
+{
+	pthread_t *handles = malloc(threads * sizeof(pthread_t));
+	contention_thread_t *args = malloc(threads * sizeof(contention_thread_t));
+	struct timespec start, end;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < threads; i++)
+	{
+		args[i].shared = shared;
+		args[i].seed = i + 1;
+		if (pthread_create(&handles[i], NULL, worker, &args[i]) != 0)
+		{
+			fprintf(stderr, "Unable to start thread %d.\n", i);
+			exit(2);
+		}
+	}
+	for (i = 0; i < threads; i++)
+		pthread_join(handles[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	free(args);
+	free(handles);
+	return elapsed_seconds(&start, &end);
+}
+
+
+int main(int argc, char **argv)
+{
+	int c, i, threads;
+	int max_threads = 64, cores = 4;
+	contention_t shared;
+
+	shared.operations = 200000;
+
+	while ((c = getopt(argc, argv, "t:n:c:")) != -1)
+	{
+		switch (c)
+		{
+			case 't':
+				max_threads = atoi(optarg);
+				break;
+
+			case 'n':
+				shared.operations = atoi(optarg);
+				break;
+
+			case 'c':
+				cores = atoi(optarg);
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (max_threads <= 0 || shared.operations <= 0 || cores <= 0)
+	{
+		fprintf(stderr, "Options -t, -n and -c require positive numbers.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	printf("%d operation(s) per thread, %d core(s) for the scheduler, %ld processor(s) online\n\n",
+	       shared.operations, cores, sysconf(_SC_NPROCESSORS_ONLN));
+	printf("threads   queue Mops/s   scheduler Mjobs/s\n");
+
+	int status = 0;
+	for (threads = 1; threads <= max_threads; threads = (threads * 2 > max_threads && threads < max_threads) ? max_threads : threads * 2)
+	{
+		priqueue_init_keyed(&shared.queue);
+		for (i = 0; i < QUEUE_PREFILL; i++)
+			priqueue_offer_key(&shared.queue, &shared, i);
+
+		double queue_seconds = run_threads(&shared, threads, queue_worker);
+		priqueue_destroy(&shared.queue);
+
+		shared.scheduler = scheduler_create(cores, SJF);
+		atomic_init(&shared.next_job, 0);
+		atomic_init(&shared.clock, 0);
+		atomic_init(&shared.finished, 0);
+
+		double scheduler_seconds = run_threads(&shared, threads, scheduler_worker);
+		scheduler_destroy(shared.scheduler);
+
+		long total = (long)threads * shared.operations;
+		printf("%7d   %12.2f   %17.2f\n", threads, 2.0 * total / queue_seconds / 1e6, total / scheduler_seconds / 1e6);
+
+		if (atomic_load(&shared.finished) != total)
+		{
+			printf("  the scheduler finished %d of %ld job(s)\n", atomic_load(&shared.finished), total);
+			status = 3;
+		}
+	}
+
+	return status;
+}
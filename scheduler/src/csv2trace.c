@@ -0,0 +1,136 @@
+/** @file csv2trace.c
+ *
+ * Converts a CSV job file into the binary trace format described in
+ * libsimulator.h, which the simulator and sweep map into memory instead of
+ * parsing.  Deadlines, if the file has any, are kept in a column after the
+ * records.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "libsimulator/libsimulator.h"
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-d] <input file> <output file>\n", program_name);
+	fprintf(stderr, "       %s -d examples/proc1.csv proc1.trace\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -d  store each arrival time as the change from the previous job's\n");
+	fprintf(stderr, "      (delta-encoded arrivals)\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "The trace is read by the simulator, sweep and throughput in place of\n");
+	fprintf(stderr, "the CSV file; deadlines in a fourth column are carried over.\n");
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+	trace_header_t header;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRACE_MAGIC, 8);
+	header.version = TRACE_VERSION;
+
+	while ((c = getopt(argc, argv, "d")) != -1)
+	{
+		switch (c)
+		{
+			case 'd':
+				header.flags |= TRACE_DELTA_ARRIVALS;
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind != argc - 2)
+	{
+		fprintf(stderr, "An input and an output file are required.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	simulator_reader_t reader;
+	int status = reader_open(&reader, argv[optind]);
+	if (status != 0)
+		return status;
+
+	FILE *out = fopen(argv[optind + 1], "wb");
+	if (out == NULL)
+	{
+		fprintf(stderr, "Unable to open file \"%s\".\n", argv[optind + 1]);
+		reader_close(&reader);
+		return 2;
+	}
+
+	// The job count goes in once it is known.
+	fwrite(&header, sizeof(header), 1, out);
+
+	simulator_job_list_t job;
+	int result, last_arrival = 0;
+	int32_t *deadlines = NULL;
+	size_t deadlines_capacity = 0;
+
+	while ((result = reader_next(&reader, &job)) > 0)
+	{
+		trace_record_t record;
+
+		record.arrival_time = job.arrival_time;
+		record.run_time = job.run_time;
+		record.priority = job.priority;
+
+		if (header.flags & TRACE_DELTA_ARRIVALS)
+		{
+			record.arrival_time -= last_arrival;
+			last_arrival = job.arrival_time;
+		}
+
+		fwrite(&record, sizeof(record), 1, out);
+
+		if (header.job_count == deadlines_capacity)
+		{
+			deadlines_capacity = deadlines_capacity ? 2 * deadlines_capacity : 1024;
+			deadlines = realloc(deadlines, deadlines_capacity * sizeof(int32_t));
+		}
+		deadlines[header.job_count++] = job.deadline;
+		if (job.deadline != -1)
+			header.flags |= TRACE_DEADLINES;
+	}
+
+	reader_close(&reader);
+
+	if (result == 0)
+	{
+		if (header.flags & TRACE_DEADLINES)
+			fwrite(deadlines, sizeof(int32_t), header.job_count, out);
+
+		rewind(out);
+		fwrite(&header, sizeof(header), 1, out);
+	}
+
+	free(deadlines);
+
+	int failed = ferror(out);
+	if (fclose(out) != 0)
+		failed = 1;
+
+	if (result == 0 && failed)
+	{
+		fprintf(stderr, "Unable to write file \"%s\".\n", argv[optind + 1]);
+		result = -1;
+	}
+
+	if (result < 0)
+	{
+		remove(argv[optind + 1]);
+		return 2;
+	}
+
+	return 0;
+}
@@ -3,9 +3,266 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
 
 #include "libpriqueue.h"
 
+
+/*
+  In a PRIQUEUE_CONCURRENT build every call below holds the queue's mutex,
+  so a queue can be shared between threads. Otherwise these are no-ops.
+ */
+#ifdef PRIQUEUE_CONCURRENT
+#define QUEUE_LOCK(q)   pthread_mutex_lock( &(q)->lock )
+#define QUEUE_UNLOCK(q) pthread_mutex_unlock( &(q)->lock )
+#else
+#define QUEUE_LOCK(q)
+#define QUEUE_UNLOCK(q)
+#endif
+
+/*
+  In a PRIQUEUE_STATS build the queue counts its operations in q->stats.
+  Otherwise these are no-ops.
+ */
+#ifdef PRIQUEUE_STATS
+#define QUEUE_COUNT(q, field) ( (q)->stats.field++ )
+#define QUEUE_PEAK(q) \
+	do { if( (q)->curr_size > (q)->stats.peak_size ) (q)->stats.peak_size = (q)->curr_size; } while( 0 )
+#else
+#define QUEUE_COUNT(q, field)
+#define QUEUE_PEAK(q)
+#endif
+
+/*
+  Heap helpers. The queue is a binary min-heap stored in q->queue_array,
+  with the children of slot i at 2i+1 and 2i+2. An entry sorts before
+  another if the comparer says so, or if the comparer calls them equal
+  and it was offered first. A keyed queue compares the keys directly, so
+  ordering it needs no call through the comparer at all.
+
+  The sift helpers also run on the sorted snapshot, which has no handles to
+  keep up to date; they only record new slots when given a slots array.
+ */
+static int entry_before(priqueue_t *q, const priqueue_entry_t *a, const priqueue_entry_t *b)
+{
+	QUEUE_COUNT(q, comparisons);
+	if( !q->comparer )
+	{
+		if( a->key != b->key )
+		{
+			return a->key < b->key;
+		}
+		return a->seq < b->seq;
+	}
+
+	int cmp = q->comparer(a->ptr, b->ptr);
+	if( cmp != 0 )
+	{
+		return cmp < 0;
+	}
+	return a->seq < b->seq;
+}
+
+static uint sift_up(priqueue_t *q, priqueue_entry_t *heap, uint idx, uint *slots)
+{
+	priqueue_entry_t moving = heap[idx];
+	while( idx > 0 )
+	{
+		uint parent = (idx - 1) / 2;
+		if( !entry_before(q, &moving, &heap[parent]) )
+		{
+			break;
+		}
+		heap[idx] = heap[parent];
+		QUEUE_COUNT(q, moves);
+		if( slots )
+		{
+			slots[heap[idx].handle] = idx;
+		}
+		idx = parent;
+	}
+	heap[idx] = moving;
+	QUEUE_COUNT(q, moves);
+	if( slots )
+	{
+		slots[moving.handle] = idx;
+	}
+	return idx;
+}
+
+static uint sift_down(priqueue_t *q, priqueue_entry_t *heap, uint size, uint idx, uint *slots)
+{
+	priqueue_entry_t moving = heap[idx];
+	while( 1 )
+	{
+		uint child = 2 * idx + 1;
+		if( child >= size )
+		{
+			break;
+		}
+		if( child + 1 < size && entry_before(q, &heap[child + 1], &heap[child]) )
+		{
+			child++;
+		}
+		if( !entry_before(q, &heap[child], &moving) )
+		{
+			break;
+		}
+		heap[idx] = heap[child];
+		QUEUE_COUNT(q, moves);
+		if( slots )
+		{
+			slots[heap[idx].handle] = idx;
+		}
+		idx = child;
+	}
+	heap[idx] = moving;
+	QUEUE_COUNT(q, moves);
+	if( slots )
+	{
+		slots[moving.handle] = idx;
+	}
+	return idx;
+}
+
+//hand out an unused handle, growing the handle table when none are free
+static int alloc_handle(priqueue_t *q)
+{
+	if( q->free_handle == -1 )
+	{
+		uint old_size = q->handle_size;
+		q->handle_size = old_size ? 2 * old_size : 2;
+		q->handle_slot = realloc(q->handle_slot, q->handle_size * sizeof(uint) );
+		for( uint h = old_size; h < q->handle_size; h++ )
+		{
+			q->handle_slot[h] = h + 1;
+		}
+		q->handle_slot[q->handle_size - 1] = -1;
+		q->free_handle = old_size;
+	}
+	int handle = q->free_handle;
+	q->free_handle = q->handle_slot[handle];
+	return handle;
+}
+
+static void release_handle(priqueue_t *q, int handle)
+{
+	q->handle_slot[handle] = q->free_handle;
+	q->free_handle = handle;
+}
+
+//a handle is live if the slot it maps to holds an entry carrying it
+static int handle_valid(priqueue_t *q, int handle)
+{
+	if( handle < 0 || handle >= q->handle_size )
+	{
+		return 0;
+	}
+	uint idx = q->handle_slot[handle];
+	return idx < q->curr_size && q->queue_array[idx].handle == handle;
+}
+
+//take the entry at heap slot idx out, filling the hole with the last entry
+static void *remove_heap_index(priqueue_t *q, uint idx)
+{
+	void *rtn = q->queue_array[idx].ptr;
+	release_handle(q, q->queue_array[idx].handle);
+
+	q->curr_size--;
+	if( idx != q->curr_size )
+	{
+		q->queue_array[idx] = q->queue_array[q->curr_size];
+		if( sift_up(q, q->queue_array, idx, q->handle_slot) == idx )
+		{
+			sift_down(q, q->queue_array, q->curr_size, idx, q->handle_slot);
+		}
+	}
+	q->ordered_valid = 0;
+	return rtn;
+}
+
+//build the sorted snapshot used for positional access
+static void build_ordered(priqueue_t *q)
+{
+	if( q->ordered_valid )
+	{
+		return;
+	}
+
+	if( q->ordered_size < q->curr_size )
+	{
+		q->ordered_array = realloc(q->ordered_array, q->curr_size * sizeof(priqueue_entry_t) );
+		q->ordered_size = q->curr_size;
+	}
+
+	//heapsort a copy of the heap; popping the minimum to the back each
+	//round leaves the copy sorted back to front, so reverse it afterwards
+	priqueue_entry_t *ordered = q->ordered_array;
+	uint size = q->curr_size;
+	for( uint i = 0; i < size; i++ )
+	{
+		ordered[i] = q->queue_array[i];
+	}
+	while( size > 1 )
+	{
+		size--;
+		priqueue_entry_t temp = ordered[0];
+		ordered[0] = ordered[size];
+		ordered[size] = temp;
+		sift_down(q, ordered, size, 0, NULL);
+	}
+	for( uint i = 0, j = q->curr_size; i + 1 < j; i++, j-- )
+	{
+		priqueue_entry_t temp = ordered[i];
+		ordered[i] = ordered[j - 1];
+		ordered[j - 1] = temp;
+	}
+
+	q->ordered_valid = 1;
+}
+
+//give the entry at heap slot idx a new key and move it to where it belongs
+static void rekey_heap_index(priqueue_t *q, uint idx, unsigned long long key)
+{
+	q->queue_array[idx].key = key;
+	if( sift_up(q, q->queue_array, idx, q->handle_slot) == idx )
+	{
+		sift_down(q, q->queue_array, q->curr_size, idx, q->handle_slot);
+	}
+	q->ordered_valid = 0;
+}
+
+static int seq_order(const void *a, const void *b)
+{
+	uint left = ((const priqueue_entry_t *)a)->seq;
+	uint right = ((const priqueue_entry_t *)b)->seq;
+	return ( left > right ) - ( left < right );
+}
+
+//make room for count more sequence numbers. Rather than run past UINT_MAX,
+//the entries queued are numbered again from 0 in the order they already
+//had, which leaves every comparison between them the same
+static void reserve_seqs(priqueue_t *q, uint count)
+{
+	if( q->next_seq <= UINT_MAX - count )
+	{
+		return;
+	}
+
+	priqueue_entry_t *sorted = malloc(q->curr_size * sizeof(priqueue_entry_t) );
+	memcpy(sorted, q->queue_array, q->curr_size * sizeof(priqueue_entry_t) );
+	qsort(sorted, q->curr_size, sizeof(priqueue_entry_t), seq_order);
+	for( uint i = 0; i < q->curr_size; i++ )
+	{
+		q->queue_array[q->handle_slot[sorted[i].handle]].seq = i;
+	}
+	free(sorted);
+
+	q->next_seq = q->curr_size;
+	q->ordered_valid = 0;
+}
+
 /**
   Initializes the priqueue_t data structure.
 
@@ -18,46 +275,160 @@
  */
 void priqueue_init(priqueue_t *q, compare_func_t comparer)
 {
-	q->queue_array = calloc (2 , sizeof(void*) );
+	q->queue_array = calloc (2 , sizeof(priqueue_entry_t) );
 	q->max_size = 2;
 	q->curr_size = 0;
+	q->next_seq = 0;
 	q->comparer = comparer;
+
+	q->handle_slot = NULL;
+	q->handle_size = 0;
+	q->free_handle = -1;
+
+	q->ordered_array = NULL;
+	q->ordered_size = 0;
+	q->ordered_valid = 0;
+
+#ifdef PRIQUEUE_CONCURRENT
+	pthread_mutex_init( &q->lock, NULL );
+#endif
+#ifdef PRIQUEUE_STATS
+	memset( &q->stats, 0, sizeof(q->stats) );
+#endif
+}
+
+/**
+  Initializes a keyed priqueue_t. Instead of calling a comparer, a keyed
+  queue orders its elements by the integer key each one is offered with,
+  smallest first, and by insertion order among equal keys. Pack whatever
+  the order depends on into the key, most significant field first.
+
+  Elements offered with priqueue_offer() get a key of 0.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+ */
+void priqueue_init_keyed(priqueue_t *q)
+{
+	priqueue_init(q, NULL);
 }
 
 
 /**
   Inserts the specified element into this priority queue.
 
+  Runs in O(log n). Elements the comparer considers equal are kept in the
+  order they were offered.
+
   @param q a pointer to an instance of the priqueue_t data structure
   @param ptr a pointer to the data to be inserted into the priority queue
-  @return The zero-based index where ptr is stored in the priority queue, where 0 indicates that ptr was stored at the front of the priority queue.
+  @return a handle naming this entry for priqueue_update() and
+  priqueue_remove_handle(). It stays valid until the entry leaves the
+  queue, after which it may be handed out again.
  */
 int priqueue_offer(priqueue_t *q, void *ptr)
 {
+	return priqueue_offer_key(q, ptr, 0);
+}
 
-	if( q->curr_size+1 >= q->max_size )
+
+/**
+  Inserts the specified element into a keyed priority queue.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptr a pointer to the data to be inserted into the priority queue
+  @param key the sort key of ptr; ignored by a queue with a comparer
+  @return a handle naming this entry, as from priqueue_offer()
+ */
+int priqueue_offer_key(priqueue_t *q, void *ptr, unsigned long long key)
+{
+	QUEUE_LOCK(q);
+	if( q->curr_size == q->max_size )
 	{
 		int new_size = 2 * q->max_size;
-		q->queue_array = realloc(q->queue_array, new_size * sizeof(void*) );
+		q->queue_array = realloc(q->queue_array, new_size * sizeof(priqueue_entry_t) );
 		q->max_size = new_size;
 	}
-	uint curr_idx = q->curr_size;
 
-	//put it in the back
-	q->queue_array[q->curr_size] = ptr;
+	//put it in the back and sift it up
+	reserve_seqs(q, 1);
+	int handle = alloc_handle(q);
+	uint curr_idx = q->curr_size;
+	q->queue_array[curr_idx].key = key;
+	q->queue_array[curr_idx].ptr = ptr;
+	q->queue_array[curr_idx].seq = q->next_seq++;
+	q->queue_array[curr_idx].handle = handle;
 	q->curr_size++;
+	q->ordered_valid = 0;
+	QUEUE_COUNT(q, offers);
+	QUEUE_PEAK(q);
+
+	sift_up(q, q->queue_array, curr_idx, q->handle_slot);
+	QUEUE_UNLOCK(q);
+	return handle;
+}
+
+
+/**
+  Inserts count elements into a keyed priority queue at once, as if each
+  were offered with priqueue_offer_key() in turn. When the batch is at
+  least as big as the queue was, the heap is rebuilt bottom up in O(n)
+  instead of sifting each element up on its own.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptrs the elements to insert, in the order they should be offered
+  @param keys the sort key of each element; ignored by a queue with a comparer
+  @param count the number of elements
+  @param handles filled in with the handle of each element, or NULL
+ */
+void priqueue_offer_keys(priqueue_t *q, void **ptrs, const unsigned long long *keys, int count, int *handles)
+{
+	QUEUE_LOCK(q);
+	uint old_size = q->curr_size;
+	if( old_size + count > q->max_size )
+	{
+		uint new_size = q->max_size;
+		while( new_size < old_size + count )
+		{
+			new_size *= 2;
+		}
+		q->queue_array = realloc(q->queue_array, new_size * sizeof(priqueue_entry_t) );
+		q->max_size = new_size;
+	}
 
-	//sift it forward
-	//we aren't being paid to be efficient. so...
-	while( curr_idx > 0 && 0 < q->comparer(q->queue_array[curr_idx-1], q->queue_array[curr_idx]) )
+	reserve_seqs(q, count);
+	for( int i = 0; i < count; i++ )
 	{
-		void *temp = q->queue_array[curr_idx-1];
-		q->queue_array[curr_idx-1] = q->queue_array[curr_idx];
-		q->queue_array[curr_idx] = temp;
-		curr_idx--;
+		priqueue_entry_t *entry = &q->queue_array[old_size + i];
+		entry->key = keys[i];
+		entry->ptr = ptrs[i];
+		entry->seq = q->next_seq++;
+		entry->handle = alloc_handle(q);
+		q->handle_slot[entry->handle] = old_size + i;
+		if( handles )
+		{
+			handles[i] = entry->handle;
+		}
+		QUEUE_COUNT(q, offers);
 	}
+	q->curr_size += count;
+	q->ordered_valid = 0;
+	QUEUE_PEAK(q);
 
-	return curr_idx;
+	if( (uint)count >= old_size )
+	{
+		for( uint idx = q->curr_size / 2; idx-- > 0; )
+		{
+			sift_down(q, q->queue_array, q->curr_size, idx, q->handle_slot);
+		}
+	}
+	else
+	{
+		for( uint idx = old_size; idx < q->curr_size; idx++ )
+		{
+			sift_up(q, q->queue_array, idx, q->handle_slot);
+		}
+	}
+	QUEUE_UNLOCK(q);
 }
 
 
@@ -71,7 +442,15 @@ int priqueue_offer(priqueue_t *q, void *ptr)
  */
 void *priqueue_peek(priqueue_t *q)
 {
-	return q->queue_array[0];
+	void *rtn = NULL;
+
+	QUEUE_LOCK(q);
+	if( q->curr_size > 0 )
+	{
+		rtn = q->queue_array[0].ptr;
+	}
+	QUEUE_UNLOCK(q);
+	return rtn;
 }
 
 
@@ -79,24 +458,23 @@ void *priqueue_peek(priqueue_t *q)
   Retrieves and removes the head of this queue, or NULL if this queue
   is empty.
 
+  Runs in O(log n).
+
   @param q a pointer to an instance of the priqueue_t data structure
   @return the head of this queue
   @return NULL if this queue is empty
  */
 void *priqueue_poll(priqueue_t *q)
 {
-	if(q->curr_size == 0 )
-	{
-		return NULL;
-	}
-	q->curr_size--;
-	void *rtn = q->queue_array[0];
-	int idx = 0;
-	while( idx < q->curr_size)
+	void *rtn = NULL;
+
+	QUEUE_LOCK(q);
+	if( q->curr_size > 0 )
 	{
-		q->queue_array[idx] = q->queue_array[idx+1];
-		idx++;
+		QUEUE_COUNT(q, polls);
+		rtn = remove_heap_index(q, 0);
 	}
+	QUEUE_UNLOCK(q);
 	return rtn;
 }
 
@@ -105,6 +483,9 @@ void *priqueue_poll(priqueue_t *q)
   Returns the element at the specified position in this list, or NULL if
   the queue does not contain an index'th element.
 
+  The first call after the queue changes sorts a snapshot of the queue in
+  O(n log n); further calls are O(1) until the queue changes again.
+
   @param q a pointer to an instance of the priqueue_t data structure
   @param index position of retrieved element
    @return the index'th element in the queue
@@ -112,11 +493,16 @@ void *priqueue_poll(priqueue_t *q)
  */
 void *priqueue_at(priqueue_t *q, int index)
 {
-	if( index >= q->max_size )
+	void *rtn = NULL;
+
+	QUEUE_LOCK(q);
+	if( index >= 0 && index < q->curr_size )
 	{
-		return NULL;
+		build_ordered(q);
+		rtn = q->ordered_array[index].ptr;
 	}
-	return q->queue_array[index];
+	QUEUE_UNLOCK(q);
+	return rtn;
 }
 
 
@@ -131,34 +517,44 @@ void *priqueue_at(priqueue_t *q, int index)
  */
 int priqueue_remove(priqueue_t *q, void *ptr)
 {
-	int idx = 0;
-	int removed = 0;
+	uint kept = 0;
 
-	while( idx < q->curr_size )
+	QUEUE_LOCK(q);
+	//drop every match in one pass, then restore the heap in O(n)
+	for( uint idx = 0; idx < q->curr_size; idx++ )
 	{
-		if ( q->queue_array[idx] == ptr )
+		if ( q->queue_array[idx].ptr != ptr )
 		{
-			removed++;
-			q->curr_size--;
-			//shift all foward
-			int temp = idx;
-			while( temp < q->curr_size )
-			{
-				q->queue_array[temp] = q->queue_array[temp+1];
-				temp++;
-			}
+			q->queue_array[kept++] = q->queue_array[idx];
 		}
 		else
 		{
-			idx++;
+			release_handle(q, q->queue_array[idx].handle);
 		}
 	}
+
+	int removed = q->curr_size - kept;
+	if( removed > 0 )
+	{
+		QUEUE_COUNT(q, removes);
+		q->curr_size = kept;
+		for( uint idx = 0; idx < kept; idx++ )
+		{
+			q->handle_slot[q->queue_array[idx].handle] = idx;
+		}
+		for( uint idx = kept / 2; idx-- > 0; )
+		{
+			sift_down(q, q->queue_array, kept, idx, q->handle_slot);
+		}
+		q->ordered_valid = 0;
+	}
+	QUEUE_UNLOCK(q);
 	return removed;
 }
 
 /**
-  Removes the specified index from the queue, moving later elements up
-  a spot in the queue to fill the gap.
+  Removes the specified index from the queue. Later elements move up a
+  spot in priority order; the heap itself is repaired in O(log n).
 
   @param q a pointer to an instance of the priqueue_t data structure
   @param index position of element to be removed
@@ -167,16 +563,95 @@ int priqueue_remove(priqueue_t *q, void *ptr)
  */
 void *priqueue_remove_at(priqueue_t *q, int index)
 {
-	void *data = q->queue_array[index];
+	void *rtn = NULL;
+
+	QUEUE_LOCK(q);
+	if( index >= 0 && index < q->curr_size )
+	{
+		build_ordered(q);
+		QUEUE_COUNT(q, removes);
+		rtn = remove_heap_index(q, q->handle_slot[q->ordered_array[index].handle]);
+	}
+	QUEUE_UNLOCK(q);
+	return rtn;
+}
+
+/**
+  Restores the position of an entry whose priority changed after it was
+  offered. Call this after changing whatever the comparer looks at; the
+  entry keeps its original insertion order for ties.
+
+  Runs in O(log n).
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle the handle priqueue_offer() returned for the entry
+  @return 0 on success
+  @return -1 if handle does not name an entry in the queue
+ */
+int priqueue_update(priqueue_t *q, int handle)
+{
+	int rtn = -1;
+
+	QUEUE_LOCK(q);
+	if( handle_valid(q, handle) )
+	{
+		uint idx = q->handle_slot[handle];
+		QUEUE_COUNT(q, updates);
+		rekey_heap_index(q, idx, q->queue_array[idx].key);
+		rtn = 0;
+	}
+	QUEUE_UNLOCK(q);
+	return rtn;
+}
+
+/**
+  Gives an entry of a keyed queue a new key and restores its position.
+
+  Runs in O(log n).
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle the handle priqueue_offer_key() returned for the entry
+  @param key the new sort key
+  @return 0 on success
+  @return -1 if handle does not name an entry in the queue
+ */
+int priqueue_update_key(priqueue_t *q, int handle, unsigned long long key)
+{
+	int rtn = -1;
 
-	int idx = index;
-	while(idx < q->curr_size)
+	QUEUE_LOCK(q);
+	if( handle_valid(q, handle) )
 	{
-		q->queue_array[idx] = q->queue_array[idx+1];
-		idx++;
+		QUEUE_COUNT(q, updates);
+		rekey_heap_index(q, q->handle_slot[handle], key);
+		rtn = 0;
 	}
+	QUEUE_UNLOCK(q);
+	return rtn;
+}
+
+/**
+  Removes the entry named by handle from the queue.
+
+  Runs in O(log n).
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle the handle priqueue_offer() returned for the entry
+  @return the element removed from the queue
+  @return NULL if handle does not name an entry in the queue
+ */
+void *priqueue_remove_handle(priqueue_t *q, int handle)
+{
+	void *rtn = NULL;
 
-	return data;
+	QUEUE_LOCK(q);
+	if( handle_valid(q, handle) )
+	{
+		QUEUE_COUNT(q, removes);
+		rtn = remove_heap_index(q, q->handle_slot[handle]);
+	}
+	QUEUE_UNLOCK(q);
+	return rtn;
 }
 
 /**
@@ -187,7 +662,28 @@ void *priqueue_remove_at(priqueue_t *q, int index)
  */
 int priqueue_size(priqueue_t *q)
 {
-	return q->curr_size;
+	QUEUE_LOCK(q);
+	int size = q->curr_size;
+	QUEUE_UNLOCK(q);
+	return size;
+}
+
+/**
+  Copies out the operation counts of q. They are all 0 unless the queue was
+  built with PRIQUEUE_STATS.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param stats where to copy the counts
+ */
+void priqueue_get_stats(priqueue_t *q, priqueue_stats_t *stats)
+{
+#ifdef PRIQUEUE_STATS
+	QUEUE_LOCK(q);
+	*stats = q->stats;
+	QUEUE_UNLOCK(q);
+#else
+	memset( stats, 0, sizeof(*stats) );
+#endif
 }
 
 /**
@@ -198,4 +694,10 @@ int priqueue_size(priqueue_t *q)
 void priqueue_destroy(priqueue_t *q)
 {
 	free( q->queue_array );
+	free( q->handle_slot );
+	free( q->ordered_array );
+
+#ifdef PRIQUEUE_CONCURRENT
+	pthread_mutex_destroy( &q->lock );
+#endif
 }
@@ -4,24 +4,97 @@
 #ifndef LIBPRIQUEUE_H_
 #define LIBPRIQUEUE_H_
 
+#ifdef PRIQUEUE_CONCURRENT
+#include <pthread.h>
+#endif
+
 typedef int (*compare_func_t) ( const void *a, const void *b);
 
+/**
+  One slot of the heap. seq is the insertion sequence number, used to break
+  ties between elements the comparer considers equal so that they leave the
+  queue in the order they were offered. handle is the stable name returned
+  by priqueue_offer(). key is the sort key of a keyed queue.
+
+  seq and handle are 32 bits each, so an entry takes 24 bytes on a 64-bit
+  machine rather than 32, and every sift moves a quarter less. Before seq
+  would wrap, the queue numbers the entries in it again from 0, in order.
+*/
+typedef struct _priqueue_entry_t
+{
+    unsigned long long key;
+    void *ptr;
+    uint seq;
+    int handle;
+} priqueue_entry_t;
+
+/**
+  Operation counts kept by a queue in a PRIQUEUE_STATS build. removes
+  covers every way of taking an entry out other than polling. moves counts
+  heap slots written while sifting.
+*/
+typedef struct _priqueue_stats_t
+{
+    unsigned long long offers;
+    unsigned long long polls;
+    unsigned long long removes;
+    unsigned long long updates;
+    unsigned long long comparisons;
+    unsigned long long moves;
+    unsigned int peak_size;
+} priqueue_stats_t;
+
 /**
   Priqueue Data Structure
+
+  A binary min-heap ordered by the comparer, then by insertion sequence.
+  A keyed queue (see priqueue_init_keyed()) has no comparer and orders
+  entries by their integer keys instead.
+  ordered_array is a sorted snapshot of the heap built on demand by
+  priqueue_at() and priqueue_remove_at(); it is thrown away by any
+  operation that changes the queue.
+
+  handle_slot maps every live handle to the heap slot holding it. Handles
+  that are not in use are chained into a free list through the same array,
+  starting at free_handle.
+
+  Built with PRIQUEUE_CONCURRENT, every call takes lock for its whole run,
+  so one queue may be used from several threads at once. Each call is
+  atomic on its own; a sequence such as a peek followed by a remove is not,
+  and needs a lock of the caller's around it.
 */
 typedef struct _priqueue_t
 {
-    void **queue_array;
+    priqueue_entry_t *queue_array;
     uint max_size;
     uint curr_size;
+    uint next_seq;
     compare_func_t comparer;
+
+    uint *handle_slot;
+    uint handle_size;
+    int free_handle;
+
+    priqueue_entry_t *ordered_array;
+    uint ordered_size;
+    int ordered_valid;
+
+#ifdef PRIQUEUE_CONCURRENT
+    pthread_mutex_t lock;
+#endif
+#ifdef PRIQUEUE_STATS
+    priqueue_stats_t stats;
+#endif
 } priqueue_t;
 
 
 
 void   priqueue_init     (priqueue_t *q, int(*comparer)(const void *, const void *));
+void   priqueue_init_keyed(priqueue_t *q);
 
 int    priqueue_offer    (priqueue_t *q, void *ptr);
+int    priqueue_offer_key(priqueue_t *q, void *ptr, unsigned long long key);
+void   priqueue_offer_keys(priqueue_t *q, void **ptrs, const unsigned long long *keys, int count, int *handles);
 void * priqueue_peek     (priqueue_t *q);
 void * priqueue_poll     (priqueue_t *q);
 void * priqueue_at       (priqueue_t *q, int index);
@@ -29,6 +102,12 @@ int    priqueue_remove   (priqueue_t *q, void *ptr);
 void * priqueue_remove_at(priqueue_t *q, int index);
 int    priqueue_size     (priqueue_t *q);
 
+int    priqueue_update       (priqueue_t *q, int handle);
+int    priqueue_update_key   (priqueue_t *q, int handle, unsigned long long key);
+void * priqueue_remove_handle(priqueue_t *q, int handle);
+
+void   priqueue_get_stats(priqueue_t *q, priqueue_stats_t *stats);
+
 void   priqueue_destroy  (priqueue_t *q);
 
 #endif /* LIBPQUEUE_H_ */
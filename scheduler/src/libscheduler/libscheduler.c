@@ -4,10 +4,73 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include "libscheduler.h"
 #include "../libpriqueue/libpriqueue.h"
 
+/*
+  In a SCHEDULER_CONCURRENT build each scheduler has a mutex, held for the
+  whole of every call that changes it, so several threads may share one.
+*/
+#ifdef SCHEDULER_CONCURRENT
+#include <pthread.h>
+#define SCHEDULER_LOCK(s)   pthread_mutex_lock( &(s)->lock )
+#define SCHEDULER_UNLOCK(s) pthread_mutex_unlock( &(s)->lock )
+#else
+#define SCHEDULER_LOCK(s)
+#define SCHEDULER_UNLOCK(s)
+#endif
+
+/*
+  In a SCHEDULER_STATS build each scheduler counts what it does in s->stats
+  and times its three event calls, in TSC cycles on x86 and nanoseconds
+  elsewhere. Otherwise these are no-ops, and scheduler_dump_stats_r()
+  prints nothing.
+*/
+#ifdef SCHEDULER_STATS
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define STATS_TICK_UNIT "cycles"
+#define statsTicks() __rdtsc()
+#else
+#include <time.h>
+#define STATS_TICK_UNIT "ns"
+static unsigned long long statsTicks(void)
+{
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
+
+typedef enum {STATS_NEW_JOB = 0, STATS_JOB_FINISHED, STATS_QUANTUM_EXPIRED, STATS_CALLS} stats_call_t;
+
+typedef struct _scheduler_stats_t
+{
+  unsigned long long calls[STATS_CALLS];
+  unsigned long long ticks[STATS_CALLS];
+  unsigned long long preemptions;
+  unsigned long long quantum_expirations;
+  unsigned long long context_switches;  // jobs put on a core
+  unsigned long long idle_scans;
+  int queued, peak_queued;
+} scheduler_stats_t;
+
+#define STATS_COUNT(s, field) ( (s)->stats.field++ )
+#define STATS_START(start) unsigned long long start = statsTicks()
+#define STATS_STOP(s, call, start) \
+  do { (s)->stats.calls[call]++; (s)->stats.ticks[call] += statsTicks() - start; } while( 0 )
+#define STATS_QUEUED(s, change) \
+  do { (s)->stats.queued += (change); \
+       if( (s)->stats.queued > (s)->stats.peak_queued ) (s)->stats.peak_queued = (s)->stats.queued; } while( 0 )
+#else
+#define STATS_COUNT(s, field)
+#define STATS_START(start)
+#define STATS_STOP(s, call, start)
+#define STATS_QUEUED(s, change)
+#endif
+
 
 /**
   Stores information making up a job to be scheduled including any statistics.
@@ -22,418 +85,2368 @@ typedef struct _job_t
   int total_time_needed;
   int last_start_time;
   int job_response_time;
+  int deadline;       // time it should be finished by, -1 for none
+
+  int core_id;        // core the job is running on, -1 while queued
+  int victim_handle;  // its handle in running_jobs while on a core
+  int home_core;      // core it last ran on, whose run queue it goes back to
+  int placed_used;    // used_time when it was last put on a core
+
+  int level;          // MLFQ level, if level_epoch is the current boost_epoch
+  int level_epoch;
+  struct _job_t *next_queued;  // the job behind it on its MLFQ level
 } job_t;
 
+//remaining time as of when the job last left a core (or arrived); a
+//running job has used up more since last_start_time
 int remainingTime(const job_t *job)
 {
     return job->total_time_needed - job->used_time;
 }
 
-typedef struct _scheduler_t
+//when a running job will finish if it keeps its core. This stays the same
+//while it runs, so comparing it orders running jobs by their remaining time
+//at any one moment without bringing any of them up to date.
+int finishTime(const job_t *job)
+{
+    return job->last_start_time + remainingTime(job);
+}
+
+//a job with no deadline sorts after every job that has one
+int jobDeadline(const job_t *job)
+{
+    return ( job->deadline < 0 ) ? INT_MAX : job->deadline;
+}
+
+//how long the job can still wait at time and finish by its deadline; a
+//running job's remaining time is counted down from when it last started
+int laxity(const job_t *job, int time)
+{
+    if( job->core_id != -1 )
+    {
+        return jobDeadline(job) - finishTime(job);
+    }
+    return jobDeadline(job) - remainingTime(job) - time;
+}
+
+/*
+  job_t records come out of a pool owned by the scheduler instead of one
+  calloc per job. Slots are carved out of chunks, each twice the size of the
+  one before; a finished job's slot goes on a free list threaded through the
+  slots themselves and is handed out again before any new chunk is made.
+  Everything is released at once in scheduler_clean_up().
+*/
+typedef union _job_slot_t
+{
+  job_t job;
+  union _job_slot_t *next_free;
+} job_slot_t;
+
+typedef struct _job_chunk_t
+{
+  struct _job_chunk_t *next;
+  int size;
+  job_slot_t slots[];
+} job_chunk_t;
+
+typedef struct _job_pool_t
+{
+  job_chunk_t *chunks;
+  job_slot_t *free_list;
+  int next_unused;    // first never-used slot in the newest chunk
+  int next_size;      // size of the next chunk to make
+} job_pool_t;
+
+#define JOB_POOL_MIN_CHUNK 64
+
+void jobPoolInit(job_pool_t *pool, int capacity)
+{
+    pool->chunks = NULL;
+    pool->free_list = NULL;
+    pool->next_unused = 0;
+    pool->next_size = capacity > JOB_POOL_MIN_CHUNK ? capacity : JOB_POOL_MIN_CHUNK;
+}
+
+job_t *jobAlloc(job_pool_t *pool)
+{
+    job_slot_t *slot = pool->free_list;
+
+    if( slot )
+    {
+        pool->free_list = slot->next_free;
+    }
+    else
+    {
+        if( !pool->chunks || pool->next_unused == pool->chunks->size )
+        {
+            job_chunk_t *chunk = malloc( sizeof(job_chunk_t) + pool->next_size * sizeof(job_slot_t) );
+            chunk->next = pool->chunks;
+            chunk->size = pool->next_size;
+            pool->chunks = chunk;
+            pool->next_unused = 0;
+            pool->next_size *= 2;
+        }
+        slot = &pool->chunks->slots[pool->next_unused++];
+    }
+
+    memset( slot, 0, sizeof(job_slot_t) );
+    return &slot->job;
+}
+
+void jobFree(job_pool_t *pool, job_t *job)
+{
+    job_slot_t *slot = (job_slot_t *)job;
+    slot->next_free = pool->free_list;
+    pool->free_list = slot;
+}
+
+void jobPoolDestroy(job_pool_t *pool)
+{
+    while( pool->chunks )
+    {
+        job_chunk_t *next = pool->chunks->next;
+        free( pool->chunks );
+        pool->chunks = next;
+    }
+    pool->free_list = NULL;
+}
+
+/*
+  Idle cores are kept as a bitmap, one bit per core, with a summary bitmap
+  one bit per word on top of it, so the lowest idle core is found with two
+  find-first-set steps instead of a sweep over every core.
+
+  For the preemptive schemes every running job is also kept in
+  running_jobs, a heap ordered so that the job a new arrival would preempt
+  is at the head.
+
+  With per-core run queues, run_queues[] replaces job_queue. A job that
+  has run goes back on the queue of the core it last ran on, and a new one
+  on the shortest queue. A core with nothing left on its own queue steals
+  the best job from the longest one. shortest_queues and longest_queues are
+  keyed heaps of the run queues by length, so both are found in O(1) and
+  kept up to date in O(log cores).
+
+  With a topology, cores are numbered socket by socket and sockets node by
+  node, so a core's socket is core_id / cores_per_socket. A core with an
+  empty queue then steals from the longest queue on its own socket, and
+  failing that on its own node, before looking anywhere else.
+*/
+/*
+  The waiting, turnaround and response time of every finished job also go
+  into a histogram each, for percentiles. Like an HDR histogram, the
+  buckets are log-linear: values below 2^HISTOGRAM_BITS get a bucket each,
+  and each power of two above that is split into HISTOGRAM_HALF buckets, so
+  a value is known to within 1/HISTOGRAM_HALF of itself. The memory taken
+  is fixed, whatever the number of jobs or the size of the values.
+*/
+#define HISTOGRAM_BITS 8
+#define HISTOGRAM_HALF ( 1 << ( HISTOGRAM_BITS - 1 ) )
+#define HISTOGRAM_BUCKETS ( ( 33 - HISTOGRAM_BITS ) * HISTOGRAM_HALF )
+
+typedef struct _histogram_t
+{
+  unsigned long long counts[HISTOGRAM_BUCKETS];
+  unsigned long long count;
+  int max;
+} histogram_t;
+
+typedef unsigned long long core_bits_t;
+#define CORE_BITS ( 8 * sizeof(core_bits_t) )
+
+/*
+  MLFQ, and FCFS, RR, PRI and PPRI while every priority fits, queue jobs in
+  bucket lists instead of job_queue: a FIFO list of jobs per bucket, linked
+  through next_queued, and a bitmap of the buckets with jobs in them, so the
+  next job is at the head of the lowest set bit. MLFQ has a bucket per
+  level, PRI and PPRI one per priority, and FCFS and RR just bucket 0.
+*/
+#define QUEUE_BUCKETS 64
+
+_Static_assert( MLFQ_MAX_LEVELS <= QUEUE_BUCKETS && PRIORITY_BUCKETS <= QUEUE_BUCKETS,
+                "every MLFQ level and bucketed priority needs a bucket" );
+
+typedef struct _run_queue_t
+{
+  priqueue_t jobs;
+  int shortest_handle;
+  int longest_handle;
+} run_queue_t;
+
+/*
+  The three event calls go straight to the copy of their path made for the
+  scheduler's scheme (see SCHEME_PATHS), picked once when it is created.
+*/
+typedef struct _scheme_paths_t
+{
+  int (*new_job)(scheduler_t *s, int job_number, int time, int running_time, int priority, int deadline);
+  int (*job_finished)(scheduler_t *s, int core_id, int job_number, int time);
+  int (*quantum_expired)(scheduler_t *s, int core_id, int time);
+} scheme_paths_t;
+
+struct _scheduler_t
 {
   scheme_t scheduler_scheme;
+  const scheme_paths_t *paths;
   priqueue_t job_queue;
 
   int core_count;
   job_t** current_jobs_on_cores;
 
-  int total_wait_time;
-  int total_response_time;
-  int total_turn_around_time;
+  core_bits_t *idle_cores;
+  core_bits_t *idle_summary;
+  int idle_count;
+
+  priqueue_t running_jobs;
+
+  run_queue_t *run_queues;  // NULL when every core shares job_queue
+  priqueue_t shortest_queues;
+  priqueue_t longest_queues;
+  int steal_count;
+
+  int cores_per_socket;  // the topology; one socket of every core without one
+  int sockets_per_node;
+  int socket_penalty;    // time a job is charged for changing sockets, or nodes
+  int node_penalty;
+  int *core_penalties;   // what the job on each core was charged, NULL without a topology
+  int migrations[MIGRATION_KINDS];
+  int migration_time;
+
+  void **batch_jobs;  // room for the part of a batch queued at once
+  unsigned long long *batch_keys;
+  int batch_capacity;
+
+  job_pool_t job_pool;
+
+  int mlfq_levels;
+  int mlfq_quantum;
+  int mlfq_boost_interval;
+  int mlfq_next_boost;
+  int boost_epoch;
+
+  int bucketed;  // whether jobs queue in the bucket lists instead of job_queue
+  job_t *bucket_head[QUEUE_BUCKETS];
+  job_t *bucket_tail[QUEUE_BUCKETS];
+  unsigned long long bucket_bits;  // bit n set if bucket n has jobs queued
+
+  long long total_wait_time;
+  long long total_response_time;
+  long long total_turn_around_time;
   int total_jobs_count;
-} scheduler_t;
 
+  histogram_t wait_times;
+  histogram_t response_times;
+  histogram_t turn_around_times;
+
+  int deadline_jobs;
+  int deadline_misses;
+  long long total_tardiness;
+  int max_tardiness;
+
+#ifdef SCHEDULER_CONCURRENT
+  pthread_mutex_t lock;
+#endif
+#ifdef SCHEDULER_STATS
+  scheduler_stats_t stats;
+#endif
+};
+
+int histogramIndex(int value)
+{
+  if( value < ( 1 << HISTOGRAM_BITS ) )
+  {
+    return value;
+  }
+  int shift = 31 - __builtin_clz( value ) - ( HISTOGRAM_BITS - 1 );
+  return shift * HISTOGRAM_HALF + ( value >> shift );
+}
+
+//the largest value that lands in bucket index
+int histogramHighest(int index)
+{
+  if( index < ( 1 << HISTOGRAM_BITS ) )
+  {
+    return index;
+  }
+  int shift = index / HISTOGRAM_HALF - 1;
+  long long top = ( (long long)( index - shift * HISTOGRAM_HALF ) + 1 ) << shift;
+  return ( top - 1 > INT_MAX ) ? INT_MAX : top - 1;
+}
+
+void histogramRecord(histogram_t *h, int value)
+{
+  if( value < 0 )
+  {
+    value = 0;
+  }
+  h->counts[ histogramIndex(value) ]++;
+  h->count++;
+  if( value > h->max )
+  {
+    h->max = value;
+  }
+}
+
+//the smallest bucket value at or below which percentile percent of the
+//values fall, never more than the largest value recorded
+int histogramPercentile(const histogram_t *h, double percentile)
+{
+  if( h->count == 0 )
+  {
+    return 0;
+  }
+
+  double rank = percentile / 100.0 * h->count;
+  unsigned long long target = (unsigned long long) rank;
+  if( target < rank )
+  {
+    target++;
+  }
+  if( target < 1 )
+  {
+    target = 1;
+  }
+
+  unsigned long long seen = 0;
+  for(int i = 0; i < HISTOGRAM_BUCKETS; i++)
+  {
+    seen += h->counts[i];
+    if( seen >= target )
+    {
+      int value = histogramHighest(i);
+      return ( value < h->max ) ? value : h->max;
+    }
+  }
+  return h->max;
+}
+
+// the scheduler behind the single-instance scheduler_*() calls
 scheduler_t *scheduler_ptr;
 
 
 //These Sort the Queues
-int FCFScompare(const void *a, const void *b)
+//job_queue is a keyed priqueue_t: each job goes in with a 64 bit key packed
+//from what its scheme sorts by, most significant field first, so ordering
+//the queue is a plain integer compare with no call through a comparer. Jobs
+//with equal keys are kept in the order they were queued, which is all FCFS
+//needs, so its key is always 0.
+//  SJF / PSJF: remaining time, then arrival time
+//  PRI / PPRI: priority, then arrival time
+//  EDF: deadline, then arrival time
+//  LLF: deadline less remaining time, then arrival time. Every queued job's
+//       laxity drops by one per time unit, so this keeps them in laxity order
+
+//The helpers on the event paths take the scheme as a parameter and are
+//always inlined, so in each scheme's copy of the paths (see SCHEME_PATHS)
+//it is a constant and the branches for the other schemes fold away.
+#define SCHEME_INLINE static inline __attribute__((always_inline))
+
+//flip the sign bit so signed ints sort correctly as unsigned
+unsigned long long keyField(int value)
 {
-  return -1;
+  return (unsigned int)value ^ 0x80000000u;
 }
 
-int SJFcompare(const void *a, const void *b)
+SCHEME_INLINE unsigned long long queueKey(scheduler_t *s, scheme_t scheme, const job_t *job)
 {
-  job_t const *left = (job_t*)a;
-  job_t const *right = (job_t*)b;
+  switch( scheme )
+  {
+    case SJF:
+    case PSJF:
+      return ( keyField( remainingTime(job) ) << 32 ) | keyField( job->arrival_time );
+    case PRI:
+    case PPRI:
+      return ( keyField( job->priority ) << 32 ) | keyField( job->arrival_time );
+    case EDF:
+      return ( keyField( jobDeadline(job) ) << 32 ) | keyField( job->arrival_time );
+    case LLF:
+      return ( keyField( jobDeadline(job) - remainingTime(job) ) << 32 ) | keyField( job->arrival_time );
+    default:
+      return 0;
+  }
+}
 
-  if( remainingTime(left) == remainingTime(right) )
+void bucketPush(scheduler_t *s, job_t *job, int bucket)
+{
+  job->next_queued = NULL;
+  if( s->bucket_tail[bucket] )
   {
-       return ( left->arrival_time - right->arrival_time ) ;
+    s->bucket_tail[bucket]->next_queued = job;
   }
   else
   {
-       return ( remainingTime(left) - remainingTime(right) ) ;
+    s->bucket_head[bucket] = job;
+  }
+  s->bucket_tail[bucket] = job;
+  s->bucket_bits |= 1ULL << bucket;
+}
+
+//PRI and PPRI break ties by arrival time, so this puts job behind every
+//job in its bucket that arrived no later. New jobs go on the tail, and a
+//preempted PPRI job arrived before everything queued behind it, so the
+//walk only passes jobs that arrived at the same time.
+void bucketInsert(scheduler_t *s, job_t *job, int bucket)
+{
+  job_t *tail = s->bucket_tail[bucket];
+  if( !tail || tail->arrival_time <= job->arrival_time )
+  {
+    bucketPush( s, job, bucket );
+    return;
+  }
+
+  job_t **link = &s->bucket_head[bucket];
+  while( (*link)->arrival_time <= job->arrival_time )
+  {
+    link = &(*link)->next_queued;
+  }
+  job->next_queued = *link;
+  *link = job;
+}
+
+job_t *bucketPop(scheduler_t *s)
+{
+  if( s->bucket_bits == 0 )
+  {
+    return NULL;
+  }
+
+  int bucket = __builtin_ctzll( s->bucket_bits );
+  job_t *job = s->bucket_head[bucket];
+
+  s->bucket_head[bucket] = job->next_queued;
+  if( !s->bucket_head[bucket] )
+  {
+    s->bucket_tail[bucket] = NULL;
+    s->bucket_bits &= ~( 1ULL << bucket );
+  }
+  return job;
+}
+
+//a job with a priority no bucket covers moves every queued job over to
+//job_queue, in order, for good
+void leaveBuckets(scheduler_t *s)
+{
+  job_t *job;
+
+  s->bucketed = 0;
+  while( ( job = bucketPop( s ) ) )
+  {
+    priqueue_offer_key( &s->job_queue, job, queueKey(s, s->scheduler_scheme, job) );
+  }
+}
+
+//MLFQ keeps a bucket list per level, so the next job to run is at the head
+//of the lowest level with jobs. A priority boost puts every job back on
+//level 0 by splicing the lists together and bumping boost_epoch, which
+//marks every job's level as stale (and so 0) without touching the jobs
+//themselves.
+int jobLevel(scheduler_t *s, const job_t *job)
+{
+  return ( job->level_epoch == s->boost_epoch ) ? job->level : 0;
+}
+
+void setJobLevel(scheduler_t *s, job_t *job, int level)
+{
+  job->level = level;
+  job->level_epoch = s->boost_epoch;
+}
+
+void mlfqBoost(scheduler_t *s, int time)
+{
+  if( s->mlfq_boost_interval <= 0 || time < s->mlfq_next_boost )
+  {
+    return;
+  }
+
+  while( s->mlfq_next_boost <= time )
+  {
+    s->mlfq_next_boost += s->mlfq_boost_interval;
+  }
+
+  for(int level = 1; level < s->mlfq_levels; level++)
+  {
+    if( !s->bucket_head[level] )
+    {
+      continue;
+    }
+
+    if( s->bucket_tail[0] )
+    {
+      s->bucket_tail[0]->next_queued = s->bucket_head[level];
+    }
+    else
+    {
+      s->bucket_head[0] = s->bucket_head[level];
+    }
+    s->bucket_tail[0] = s->bucket_tail[level];
+    s->bucket_head[level] = s->bucket_tail[level] = NULL;
+  }
+  s->bucket_bits = s->bucket_head[0] ? 1 : 0;
+  s->boost_epoch++;
+
+  // running jobs are back on level 0 too, which reorders the victim heap
+  for(int i = 0; i < s->core_count; i++)
+  {
+    job_t *job = s->current_jobs_on_cores[i];
+    if( job )
+    {
+      setJobLevel( s, job, 0 );
+      priqueue_update( &s->running_jobs, job->victim_handle );
+    }
+  }
+}
+
+//shortest first, ties to the lowest core
+unsigned long long shortestKey(scheduler_t *s, run_queue_t *rq)
+{
+  return ( (unsigned long long) priqueue_size( &rq->jobs ) << 32 ) | (unsigned int)( rq - s->run_queues );
+}
+
+//longest first, ties to the lowest core
+unsigned long long longestKey(scheduler_t *s, run_queue_t *rq)
+{
+  return ( (unsigned long long)( 0xFFFFFFFFu - priqueue_size( &rq->jobs ) ) << 32 ) | (unsigned int)( rq - s->run_queues );
+}
+
+void runQueueResized(scheduler_t *s, run_queue_t *rq)
+{
+  priqueue_update_key( &s->shortest_queues, rq->shortest_handle, shortestKey(s, rq) );
+  priqueue_update_key( &s->longest_queues, rq->longest_handle, longestKey(s, rq) );
+}
+
+SCHEME_INLINE void queueJob(scheduler_t *s, scheme_t scheme, job_t *job)
+{
+  STATS_QUEUED( s, 1 );
+  if( scheme == MLFQ )
+  {
+    bucketPush( s, job, jobLevel(s, job) );
+    return;
+  }
+  if( s->run_queues )
+  {
+    run_queue_t *rq = ( job->home_core >= 0 ) ? &s->run_queues[job->home_core] : priqueue_peek( &s->shortest_queues );
+    priqueue_offer_key( &rq->jobs, job, queueKey(s, scheme, job) );
+    runQueueResized( s, rq );
+    return;
+  }
+  if( s->bucketed )
+  {
+    if( scheme == FCFS || scheme == RR )
+    {
+      bucketPush( s, job, 0 );
+      return;
+    }
+    if( job->priority >= 0 && job->priority < PRIORITY_BUCKETS )
+    {
+      bucketInsert( s, job, job->priority );
+      return;
+    }
+    leaveBuckets( s );
+  }
+  priqueue_offer_key( &s->job_queue, job, queueKey(s, scheme, job) );
+}
+
+//the longest of the run queues of cores first to first + count - 1,
+//ties to the lowest core, or NULL if they are all empty
+run_queue_t *longestQueueIn(scheduler_t *s, int first, int count)
+{
+  run_queue_t *longest = NULL;
+  int end = ( first + count < s->core_count ) ? first + count : s->core_count;
+
+  for(int i = first; i < end; i++)
+  {
+    int size = priqueue_size( &s->run_queues[i].jobs );
+    if( size > 0 && ( !longest || size > priqueue_size( &longest->jobs ) ) )
+    {
+      longest = &s->run_queues[i];
+    }
+  }
+  return longest;
+}
+
+//the run queue core_id steals from, nearest first, or NULL if every queue
+//is empty
+run_queue_t *stealQueue(scheduler_t *s, int core_id)
+{
+  run_queue_t *rq;
+
+  if( s->core_penalties )
+  {
+    int node_cores = s->cores_per_socket * s->sockets_per_node;
+
+    if( ( rq = longestQueueIn( s, core_id - core_id % s->cores_per_socket, s->cores_per_socket ) ) ||
+        ( rq = longestQueueIn( s, core_id - core_id % node_cores, node_cores ) ) )
+    {
+      return rq;
+    }
+  }
+
+  rq = priqueue_peek( &s->longest_queues );
+  return ( priqueue_size( &rq->jobs ) > 0 ) ? rq : NULL;
+}
+
+//the next job for core_id, or NULL if there are none left anywhere
+SCHEME_INLINE job_t *takeJob(scheduler_t *s, scheme_t scheme, int core_id)
+{
+  if( scheme == MLFQ || s->bucketed )
+  {
+    return bucketPop( s );
+  }
+  if( s->run_queues )
+  {
+    run_queue_t *rq = &s->run_queues[core_id];
+    if( priqueue_size( &rq->jobs ) == 0 )
+    {
+      rq = stealQueue( s, core_id );
+      if( !rq )
+      {
+        return NULL;
+      }
+      s->steal_count++;
+    }
+
+    job_t *job = priqueue_poll( &rq->jobs );
+    runQueueResized( s, rq );
+    return job;
+  }
+  return priqueue_poll( &s->job_queue );
+}
+
+//whether a job that lost core_id would find any other job queued for it
+SCHEME_INLINE int jobsWaiting(scheduler_t *s, scheme_t scheme, int core_id)
+{
+  if( scheme == MLFQ || s->bucketed )
+  {
+    return s->bucket_bits != 0;
+  }
+  if( s->run_queues )
+  {
+    return priqueue_size( &s->run_queues[core_id].jobs ) > 0;
+  }
+  return priqueue_size( &s->job_queue ) > 0;
+}
+
+SCHEME_INLINE job_t *nextJob(scheduler_t *s, scheme_t scheme, int core_id)
+{
+  job_t *job = takeJob( s, scheme, core_id );
+  if( job )
+  {
+    STATS_QUEUED( s, -1 );
   }
+  return job;
 }
 
-int PRIcompare(const void *a, const void *b)
+//These order running_jobs so the preemption victim comes first: the most
+//remaining time (or the worst priority), then the latest arrival, then the
+//lowest core, which is the job the old sweep over the cores settled on.
+//PSJF compares finish times, which order running jobs the same way their
+//remaining time right now does.
+int PSJFvictimCompare(const void *a, const void *b)
 {
   job_t const *left = (job_t*)a;
   job_t const *right = (job_t*)b;
 
-  if( left->priority == right->priority)
+  if( finishTime(left) != finishTime(right) )
   {
-    return (right->arrival_time - left->arrival_time) * -1;
+    return ( finishTime(left) > finishTime(right) ) ? -1 : 1;
   }
-  else
+  else if( left->arrival_time != right->arrival_time )
   {
-    return (right->priority - left->priority) * -1;
+    return ( left->arrival_time > right->arrival_time ) ? -1 : 1;
   }
+  return left->core_id - right->core_id;
+}
+
+//MLFQ victims are the jobs on the lowest level (the highest level number).
+//The comparer can't see the boost epoch, so mlfqBoost() makes the levels of
+//running jobs current itself.
+int MLFQvictimCompare(const void *a, const void *b)
+{
+  job_t const *left = (job_t*)a;
+  job_t const *right = (job_t*)b;
 
+  if( left->level != right->level )
+  {
+    return ( left->level > right->level ) ? -1 : 1;
+  }
+  else if( left->arrival_time != right->arrival_time )
+  {
+    return ( left->arrival_time > right->arrival_time ) ? -1 : 1;
+  }
+  return left->core_id - right->core_id;
 }
 
-/**
-  Initalizes the scheduler.
+int EDFvictimCompare(const void *a, const void *b)
+{
+  job_t const *left = (job_t*)a;
+  job_t const *right = (job_t*)b;
 
-  Assumptions:
-    - You may assume this will be the first scheduler function called.
-    - You may assume this function will be called once once.
-    - You may assume that cores is a positive, non-zero number.
-    - You may assume that scheme is a valid scheduling scheme.
+  if( jobDeadline(left) != jobDeadline(right) )
+  {
+    return ( jobDeadline(left) > jobDeadline(right) ) ? -1 : 1;
+  }
+  else if( left->arrival_time != right->arrival_time )
+  {
+    return ( left->arrival_time > right->arrival_time ) ? -1 : 1;
+  }
+  return left->core_id - right->core_id;
+}
 
-  @param cores the number of cores that is available by the scheduler. These cores will be known as core(id=0), core(id=1), ..., core(id=cores-1).
-  @param scheme  the scheduling scheme that should be used. This value will be one of the six enum values of scheme_t
-*/
-void scheduler_start_up(int cores, scheme_t scheme)
+//A running job's laxity stays the same as time passes, so LLF victims are
+//ordered by their laxity as of when they started, most slack first.
+int LLFvictimCompare(const void *a, const void *b)
 {
-    scheduler_ptr = (scheduler_t *) calloc( 1, sizeof(scheduler_t) );
-	scheduler_ptr->core_count = cores;
-	scheduler_ptr->current_jobs_on_cores = (job_t **) calloc( cores , sizeof(job_t*) );
-    scheduler_ptr->scheduler_scheme = scheme;
+  job_t const *left = (job_t*)a;
+  job_t const *right = (job_t*)b;
+  int left_laxity = laxity( left, left->last_start_time );
+  int right_laxity = laxity( right, right->last_start_time );
 
-	switch(scheme)
-	{
-		case FCFS:
-		case RR:
-			priqueue_init(&scheduler_ptr->job_queue, FCFScompare);
-			break;
-		case SJF:
-		case PSJF:
-			priqueue_init(&scheduler_ptr->job_queue, SJFcompare);
-			break;
-		case PRI:
-		case PPRI:
-			priqueue_init(&scheduler_ptr->job_queue, PRIcompare);
-			break;
+  if( left_laxity != right_laxity )
+  {
+    return ( left_laxity > right_laxity ) ? -1 : 1;
+  }
+  else if( left->arrival_time != right->arrival_time )
+  {
+    return ( left->arrival_time > right->arrival_time ) ? -1 : 1;
+  }
+  return left->core_id - right->core_id;
+}
+
+int PPRIvictimCompare(const void *a, const void *b)
+{
+  job_t const *left = (job_t*)a;
+  job_t const *right = (job_t*)b;
+
+  if( left->priority != right->priority )
+  {
+    return ( left->priority > right->priority ) ? -1 : 1;
+  }
+  else if( left->arrival_time != right->arrival_time )
+  {
+    return ( left->arrival_time > right->arrival_time ) ? -1 : 1;
+  }
+  return left->core_id - right->core_id;
+}
+
+const scheme_paths_t *schemePaths(scheme_t scheme);
+
+/**
+  Creates a scheduler. Any number of schedulers can exist at once; each
+  one is independent of the others and is driven by the scheduler_*_r()
+  calls given its handle.
+
+  Assumptions:
+    - You may assume that cores is a positive, non-zero number.
+    - You may assume that scheme is a valid scheduling scheme.
+
+  @param cores the number of cores that is available by the scheduler. These cores will be known as core(id=0), core(id=1), ..., core(id=cores-1).
+  @param scheme  the scheduling scheme that should be used. This value will be one of the enum values of scheme_t
+  @return the new scheduler, to be released with scheduler_destroy()
+*/
+scheduler_t *scheduler_create(int cores, scheme_t scheme)
+{
+    return scheduler_create_with_capacity( cores, scheme, 0 );
+}
+
+/**
+  Creates a scheduler like scheduler_create(), and sizes its job pool up
+  front for the given number of jobs so that no more memory has to be
+  found for job records until that many are in the system at once.
+
+  @param cores the number of cores that is available by the scheduler.
+  @param scheme the scheduling scheme that should be used.
+  @param job_capacity how many jobs to make room for, or 0 for no hint.
+  @return the new scheduler, to be released with scheduler_destroy()
+*/
+scheduler_t *scheduler_create_with_capacity(int cores, scheme_t scheme, int job_capacity)
+{
+    scheduler_t *s = (scheduler_t *) calloc( 1, sizeof(scheduler_t) );
+    jobPoolInit( &s->job_pool, job_capacity );
+	s->core_count = cores;
+	s->current_jobs_on_cores = (job_t **) calloc( cores , sizeof(job_t*) );
+    s->scheduler_scheme = scheme;
+    s->paths = schemePaths( scheme );
+    s->cores_per_socket = cores;
+    s->sockets_per_node = 1;
+
+    // every core starts out idle
+    int words = ( cores + CORE_BITS - 1 ) / CORE_BITS;
+    int summary_words = ( words + CORE_BITS - 1 ) / CORE_BITS;
+    s->idle_cores = (core_bits_t *) calloc( words, sizeof(core_bits_t) );
+    s->idle_summary = (core_bits_t *) calloc( summary_words, sizeof(core_bits_t) );
+    s->idle_count = cores;
+    for(int i = 0; i < cores; i++)
+    {
+        s->idle_cores[i / CORE_BITS] |= 1ULL << ( i % CORE_BITS );
+    }
+    for(int w = 0; w < words; w++)
+    {
+        s->idle_summary[w / CORE_BITS] |= 1ULL << ( w % CORE_BITS );
+    }
+
+#ifdef SCHEDULER_CONCURRENT
+    pthread_mutex_init( &s->lock, NULL );
+#endif
+	priqueue_init_keyed(&s->job_queue);
+    s->bucketed = ( scheme == FCFS || scheme == RR || scheme == PRI || scheme == PPRI );
+
+	switch(scheme)
+	{
+		case PSJF:
+			priqueue_init(&s->running_jobs, PSJFvictimCompare);
+			break;
+		case PPRI:
+			priqueue_init(&s->running_jobs, PPRIvictimCompare);
+			break;
+		case EDF:
+			priqueue_init(&s->running_jobs, EDFvictimCompare);
+			break;
+		case LLF:
+			priqueue_init(&s->running_jobs, LLFvictimCompare);
+			break;
+		case MLFQ:
+			priqueue_init(&s->running_jobs, MLFQvictimCompare);
+			scheduler_set_mlfq_r( s, MLFQ_DEFAULT_LEVELS, MLFQ_DEFAULT_QUANTUM, MLFQ_DEFAULT_BOOST );
+			break;
+		default:
+			break;
+	}
+
+	return s;
+}
+
+/**
+  Sets up the levels of an MLFQ scheduler. Level n has a quantum of
+  base_quantum << n; a job starts on level 0 and drops a level each time
+  its quantum expires, until it reaches the last one. Every boost_interval
+  time units every job goes back to level 0.
+
+  Quanta that would not fit in an int are held at INT_MAX.
+
+  Assumptions:
+    - This is called before any job arrives.
+
+  @param s the scheduler, created with the MLFQ scheme
+  @param levels the number of levels, from 1 to MLFQ_MAX_LEVELS
+  @param base_quantum the quantum of level 0, at least 1
+  @param boost_interval the time between boosts, or 0 for none
+  @return 0, or -1 if a setting is out of range, leaving the old ones
+*/
+int scheduler_set_mlfq_r(scheduler_t *s, int levels, int base_quantum, int boost_interval)
+{
+    if( levels < 1 || levels > MLFQ_MAX_LEVELS || base_quantum < 1 || boost_interval < 0 )
+    {
+        return -1;
+    }
+
+    s->mlfq_levels = levels;
+    s->mlfq_quantum = base_quantum;
+    s->mlfq_boost_interval = boost_interval;
+    s->mlfq_next_boost = boost_interval;
+    return 0;
+}
+
+//base_quantum << level, or INT_MAX if that would not fit
+int mlfqQuantum(scheduler_t *s, int level)
+{
+    if( level >= 31 || s->mlfq_quantum > ( INT_MAX >> level ) )
+    {
+        return INT_MAX;
+    }
+    return s->mlfq_quantum << level;
+}
+
+/**
+  Returns the quantum the job now running on core_id should be given. Under
+  MLFQ this depends on the job's level, so the simulator asks whenever it
+  starts a core's quantum clock over.
+
+  @param s the scheduler
+  @param core_id the zero-based index of the core
+  @return the quantum for the job on core_id
+  @return 0 if the core is idle or the scheme is not MLFQ
+*/
+int scheduler_core_quantum_r(scheduler_t *s, int core_id)
+{
+    int quantum = 0;
+
+    SCHEDULER_LOCK( s );
+    job_t *job = s->current_jobs_on_cores[core_id];
+    if( s->scheduler_scheme == MLFQ && job )
+    {
+        quantum = mlfqQuantum( s, jobLevel( s, job ) );
+    }
+    SCHEDULER_UNLOCK( s );
+    return quantum;
+}
+
+/**
+  Gives every core its own run queue instead of one queue shared by all of
+  them. Jobs that have run go back on the queue of the core they last ran
+  on. New jobs go on the shortest queue, a core whose own queue is empty
+  takes the best job from the longest one, and
+  scheduler_steal_count_r() counts how often that happened. MLFQ keeps its
+  shared levels either way.
+
+  Assumptions:
+    - This is called before any job arrives.
+
+  @param s the scheduler
+*/
+void scheduler_use_run_queues_r(scheduler_t *s)
+{
+    if( s->run_queues )
+    {
+        return;
+    }
+
+    s->bucketed = 0;
+    s->run_queues = (run_queue_t *) calloc( s->core_count, sizeof(run_queue_t) );
+    priqueue_init_keyed( &s->shortest_queues );
+    priqueue_init_keyed( &s->longest_queues );
+    for(int i = 0; i < s->core_count; i++)
+    {
+        run_queue_t *rq = &s->run_queues[i];
+        priqueue_init_keyed( &rq->jobs );
+        rq->shortest_handle = priqueue_offer_key( &s->shortest_queues, rq, shortestKey(s, rq) );
+        rq->longest_handle = priqueue_offer_key( &s->longest_queues, rq, longestKey(s, rq) );
+    }
+}
+
+/**
+  Returns how many times a core took a job from another core's run queue.
+
+  @param s the scheduler
+  @return the number of steals, 0 without per-core run queues
+*/
+int scheduler_steal_count_r(scheduler_t *s)
+{
+    return s->steal_count;
+}
+
+/**
+  Describes the machine the cores belong to: nodes of sockets_per_node
+  sockets, each of cores_per_socket cores, numbered socket by socket. A job
+  put on a core other than the one it last ran on is counted as a
+  migration, and one that leaves its socket is charged socket_penalty more
+  time to run, or node_penalty if it leaves its node too, for the cache it
+  leaves behind, but never more than half the time it ran on the core it
+  left. The simulator adds what a job was charged to its running
+  time (see scheduler_core_penalty_r()), and it counts as running time
+  rather than waiting time in the averages. With per-core run queues, a core
+  steals from its own socket, then its own node, before anywhere else.
+
+  Without a topology every core is on the one socket and nothing is
+  charged, but migrations are still counted.
+
+  Assumptions:
+    - This is called before any job arrives.
+
+  @param s the scheduler
+  @param cores_per_socket the number of cores in each socket
+  @param sockets_per_node the number of sockets in each node
+  @param socket_penalty the time charged for moving to another socket on the same node
+  @param node_penalty the time charged for moving to another node
+*/
+void scheduler_set_topology_r(scheduler_t *s, int cores_per_socket, int sockets_per_node, int socket_penalty, int node_penalty)
+{
+    s->cores_per_socket = cores_per_socket;
+    s->sockets_per_node = sockets_per_node;
+    s->socket_penalty = socket_penalty;
+    s->node_penalty = node_penalty;
+    if( !s->core_penalties )
+    {
+        s->core_penalties = (int *) calloc( s->core_count, sizeof(int) );
+    }
+}
+
+/**
+  Returns the migration penalty the job now on core_id was charged when it
+  was put there, which the simulator adds to the job's running time.
+
+  @param s the scheduler
+  @param core_id the zero-based index of the core
+  @return the time charged, 0 if the job did not change sockets or there is no topology
+*/
+int scheduler_core_penalty_r(scheduler_t *s, int core_id)
+{
+    return s->core_penalties ? s->core_penalties[core_id] : 0;
+}
+
+/**
+  Returns how many times a job was put on a core other than the one it last
+  ran on, that far away.
+
+  @param s the scheduler
+  @param kind how far the job moved
+  @return the number of migrations
+*/
+int scheduler_migrations_r(scheduler_t *s, migration_t kind)
+{
+    return s->migrations[kind];
+}
+
+/**
+  Returns the total time jobs were charged for migrating.
+
+  @param s the scheduler
+  @return the time charged, 0 without a topology
+*/
+int scheduler_migration_time_r(scheduler_t *s)
+{
+    return s->migration_time;
+}
+
+SCHEME_INLINE int schemeTracksVictims(scheme_t scheme)
+{
+    return scheme == PSJF || scheme == PPRI || scheme == MLFQ || scheme == EDF || scheme == LLF;
+}
+
+int tracksVictims(scheduler_t *s)
+{
+    return schemeTracksVictims( s->scheduler_scheme );
+}
+
+//counts job moving from the core it last ran on to core_id, and charges it
+//for leaving its socket or node. The charge is never more than half the
+//time the job ran on the core it left, so a job moved after every short
+//quantum still gets somewhere.
+void chargeMigration(scheduler_t *s, job_t *job, int core_id)
+{
+    int penalty = 0;
+
+    if( job->home_core >= 0 && job->home_core != core_id )
+    {
+        int from = job->home_core / s->cores_per_socket;
+        int to = core_id / s->cores_per_socket;
+        migration_t kind = MIGRATION_CORE;
+
+        if( from / s->sockets_per_node != to / s->sockets_per_node )
+        {
+            kind = MIGRATION_NODE;
+            penalty = s->node_penalty;
+        }
+        else if( from != to )
+        {
+            kind = MIGRATION_SOCKET;
+            penalty = s->socket_penalty;
+        }
+
+        int ran = job->used_time - job->placed_used;
+        if( penalty > ran / 2 )
+        {
+            penalty = ran / 2;
+        }
+        s->migrations[kind]++;
+        s->migration_time += penalty;
+        job->total_time_needed += penalty;
+    }
+
+    if( s->core_penalties )
+    {
+        s->core_penalties[core_id] = penalty;
+    }
+    job->placed_used = job->used_time;
+}
+
+/**
+  Puts job on core_id, or leaves the core idle if job is NULL, keeping the
+  idle bitmap and the running job heap in step. Whatever was on the core
+  before is simply taken off it.
+*/
+SCHEME_INLINE void assignCore(scheduler_t *s, scheme_t scheme, int core_id, job_t *job)
+{
+    job_t *old_job = s->current_jobs_on_cores[core_id];
+    int word = core_id / CORE_BITS;
+    core_bits_t bit = 1ULL << ( core_id % CORE_BITS );
+
+    if( old_job )
+    {
+        if( schemeTracksVictims(scheme) )
+        {
+            priqueue_remove_handle( &s->running_jobs, old_job->victim_handle );
+        }
+        old_job->core_id = -1;
+    }
+    else if( job )
+    {
+        s->idle_count--;
+        s->idle_cores[word] &= ~bit;
+        if( s->idle_cores[word] == 0 )
+        {
+            s->idle_summary[word / CORE_BITS] &= ~( 1ULL << ( word % CORE_BITS ) );
+        }
+    }
+
+    if( job )
+    {
+        STATS_COUNT( s, context_switches );
+        chargeMigration( s, job, core_id );
+        job->core_id = core_id;
+        job->home_core = core_id;
+        if( schemeTracksVictims(scheme) )
+        {
+            job->victim_handle = priqueue_offer( &s->running_jobs, job );
+        }
+    }
+    else if( old_job )
+    {
+        s->idle_count++;
+        s->idle_cores[word] |= bit;
+        s->idle_summary[word / CORE_BITS] |= 1ULL << ( word % CORE_BITS );
+    }
+
+    s->current_jobs_on_cores[core_id] = job;
+}
+
+int idleCore(scheduler_t *s)
+{
+    STATS_COUNT( s, idle_scans );
+    if( s->idle_count == 0 )
+    {
+        return -1;
+    }
+
+    int summary_word = 0;
+    while( s->idle_summary[summary_word] == 0 )
+    {
+        summary_word++;
+    }
+    int word = summary_word * CORE_BITS + __builtin_ctzll( s->idle_summary[summary_word] );
+    return word * CORE_BITS + __builtin_ctzll( s->idle_cores[word] );
+}
+
+int findLongestRemainingJob(scheduler_t *s)
+{
+    job_t *victim = priqueue_peek( &s->running_jobs );
+    return victim ? victim->core_id : -1;
+}
+
+int findWorstPriorityJob(scheduler_t *s)
+{
+    job_t *victim = priqueue_peek( &s->running_jobs );
+    return victim ? victim->core_id : -1;
+}
+
+//scheduler_new_deadline_job_r() without the lock
+job_t *newJob(scheduler_t *s, int job_number, int time, int running_time, int priority, int deadline)
+{
+    job_t* job = jobAlloc( &s->job_pool );
+    job->pid = job_number;
+    job->arrival_time = time;
+    job->priority = priority;
+    job->total_time_needed = running_time;
+    job->used_time = 0;
+    job->last_start_time = 0;
+    job->job_response_time = 0;
+    job->deadline = deadline;
+    job->core_id = -1;
+    job->victim_handle = -1;
+    job->home_core = -1;
+    return job;
+}
+
+SCHEME_INLINE int addJob(scheduler_t *s, scheme_t scheme, int job_number, int time, int running_time, int priority, int deadline)
+{
+    job_t* job = newJob( s, job_number, time, running_time, priority, deadline );
+
+    if( scheme == MLFQ )
+    {
+        mlfqBoost( s, time );
+        setJobLevel( s, job, 0 );
+    }
+    //either schedule it or place it in the queue;
+
+    int first_core = idleCore(s);
+    if( first_core != -1 )
+    {
+        job->last_start_time = time;
+        assignCore( s, scheme, first_core, job );
+        return first_core;
+    }
+
+
+    if( scheme == PSJF )
+    {
+        int longest_job = findLongestRemainingJob(s);
+        int longest_job_current_remaining_time = finishTime( s->current_jobs_on_cores[longest_job] ) - time;
+
+        if( longest_job_current_remaining_time <=  job->total_time_needed )
+        {
+            // all jobs on cores have lower times, thus higher priority, add this one to queue
+            queueJob( s, scheme, job );
+            return -1;
+        }
+        else
+        {
+            //remove old
+            job_t *old_job = s->current_jobs_on_cores[longest_job];
+            //log how much time it used
+            old_job->used_time += (time - old_job->last_start_time );
+
+            //replace with new
+            job->last_start_time = time;
+            assignCore( s, scheme, longest_job, job );
+
+            //push old to queue
+            STATS_COUNT( s, preemptions );
+            queueJob( s, scheme, old_job );
+            return longest_job;
+        }
+    }
+    else if( scheme == PPRI )
+    {
+        int worst_priority_idx =  findWorstPriorityJob(s);
+
+        if( s->current_jobs_on_cores[worst_priority_idx]->priority <= job->priority )
+        {
+            // all jobs on cores have lower times, thus higher priority, add this one to queue
+            queueJob( s, scheme, job );
+            return -1;
+        }
+        else
+        {
+            //remove old
+            job_t *old_job = s->current_jobs_on_cores[worst_priority_idx];
+            //log how much time it used
+            old_job->used_time += (time - old_job->last_start_time );
+
+            //replace with new
+            job->last_start_time = time;
+            assignCore( s, scheme, worst_priority_idx, job );
+
+            //push old to queue
+            STATS_COUNT( s, preemptions );
+            queueJob( s, scheme, old_job );
+            return worst_priority_idx;
+        }
+
+    }
+    else if( scheme == EDF || scheme == LLF )
+    {
+        job_t *old_job = priqueue_peek( &s->running_jobs );
+        int preempts = ( scheme == EDF ) ? jobDeadline( job ) < jobDeadline( old_job )
+                                         : laxity( job, time ) < laxity( old_job, time );
+
+        if( !preempts )
+        {
+            queueJob( s, scheme, job );
+            return -1;
+        }
+        else
+        {
+            int core_id = old_job->core_id;
+            old_job->used_time += (time - old_job->last_start_time );
+
+            job->last_start_time = time;
+            assignCore( s, scheme, core_id, job );
+
+            STATS_COUNT( s, preemptions );
+            queueJob( s, scheme, old_job );
+            return core_id;
+        }
+    }
+    else if( scheme == MLFQ )
+    {
+        job_t *old_job = priqueue_peek( &s->running_jobs );
+
+        if( jobLevel( s, old_job ) == 0 )
+        {
+            // everything running is on the top level already
+            queueJob( s, scheme, job );
+            return -1;
+        }
+        else
+        {
+            int core_id = old_job->core_id;
+            old_job->used_time += (time - old_job->last_start_time );
+
+            job->last_start_time = time;
+            assignCore( s, scheme, core_id, job );
+
+            STATS_COUNT( s, preemptions );
+            queueJob( s, scheme, old_job );
+            return core_id;
+        }
+    }
+    else if( scheme == RR || scheme == PRI || scheme == FCFS || scheme == SJF )
+    {
+    	if( first_core == -1 )
+    	{
+    		queueJob( s, scheme, job );
+    	}
+    }
+    return -1;
+}
+
+/**
+  Called when a new job arrives.
+
+  If multiple cores are idle, the job should be assigned to the core with the
+  lowest id.
+  If the job arriving should be scheduled to run during the next
+  time cycle, return the zero-based index of the core the job should be
+  scheduled on. If another job is already running on the core specified,
+  this will preempt the currently running job.
+  Assumptions:
+    - You may assume that every job wil have a unique arrival time.
+
+  @param s the scheduler
+  @param job_number a globally unique identification number of the job arriving.
+  @param time the current time of the simulator.
+  @param running_time the total number of time units this job will run before it will be finished.
+  @param priority the priority of the job. (The lower the value, the higher the priority.)
+  @return index of core job should be scheduled on
+  @return -1 if no scheduling changes should be made.
+
+ */
+int scheduler_new_job_r(scheduler_t *s, int job_number, int time, int running_time, int priority)
+{
+    return scheduler_new_deadline_job_r( s, job_number, time, running_time, priority, -1 );
+}
+
+/**
+  Called when a new job with a deadline arrives, like
+  scheduler_new_job_r(). EDF and LLF schedule by the deadline, and every
+  scheme counts the jobs that finish after theirs.
+
+  @param s the scheduler
+  @param job_number a globally unique identification number of the job arriving.
+  @param time the current time of the simulator.
+  @param running_time the total number of time units this job will run before it will be finished.
+  @param priority the priority of the job. (The lower the value, the higher the priority.)
+  @param deadline the time the job should be finished by, or -1 for none.
+  @return index of core job should be scheduled on
+  @return -1 if no scheduling changes should be made.
+ */
+int scheduler_new_deadline_job_r(scheduler_t *s, int job_number, int time, int running_time, int priority, int deadline)
+{
+    SCHEDULER_LOCK( s );
+    STATS_START( start );
+    int core_id = s->paths->new_job( s, job_number, time, running_time, priority, deadline );
+    STATS_STOP( s, STATS_NEW_JOB, start );
+    SCHEDULER_UNLOCK( s );
+    return core_id;
+}
+
+//whether a job arriving while every core is busy just goes on job_queue,
+//so the rest of a batch can be queued all at once
+int queuesBatches(scheduler_t *s)
+{
+    return !tracksVictims(s) && !s->bucketed && !s->run_queues;
+}
+
+//scheduler_new_jobs_r() without the lock
+int addJobs(scheduler_t *s, const scheduler_job_desc_t *jobs, int count, int time, int *core_ids)
+{
+    int i, assigned = 0;
+
+    for(i = 0; i < count && ( s->idle_count > 0 || !queuesBatches(s) ); i++)
+    {
+        const scheduler_job_desc_t *d = &jobs[i];
+        core_ids[i] = s->paths->new_job( s, d->job_number, time, d->running_time, d->priority, d->deadline );
+        if( core_ids[i] != -1 )
+        {
+            assigned++;
+        }
+    }
+
+    int rest = count - i;
+    if( rest == 0 )
+    {
+        return assigned;
+    }
+
+    if( s->batch_capacity < rest )
+    {
+        s->batch_capacity = rest;
+        s->batch_jobs = (void **) realloc( s->batch_jobs, rest * sizeof(void *) );
+        s->batch_keys = (unsigned long long *) realloc( s->batch_keys, rest * sizeof(unsigned long long) );
+    }
+    for(int j = 0; j < rest; j++, i++)
+    {
+        const scheduler_job_desc_t *d = &jobs[i];
+        job_t *job = newJob( s, d->job_number, time, d->running_time, d->priority, d->deadline );
+        s->batch_jobs[j] = job;
+        s->batch_keys[j] = queueKey( s, s->scheduler_scheme, job );
+        core_ids[i] = -1;
+    }
+    priqueue_offer_keys( &s->job_queue, s->batch_jobs, s->batch_keys, rest, NULL );
+    STATS_QUEUED( s, rest );
+    return assigned;
+}
+
+/**
+  Called when several jobs arrive at the same time. Does the same as
+  calling scheduler_new_deadline_job_r() on each job in jobs[] in turn,
+  leaving what each call would have returned in core_ids[], but under one
+  lock, and once every core is busy a scheme that cannot preempt queues the
+  rest of the batch in one go.
+
+  A later job in the batch may take the core an earlier one was given, so
+  core_ids[] should be acted on in order, as the single calls would be.
+
+  @param s the scheduler
+  @param jobs the jobs arriving, in the order they would be passed one at a time
+  @param count the number of jobs
+  @param time the current time of the simulator.
+  @param core_ids filled in with the core each job should be scheduled on, or -1
+  @return the number of jobs given a core
+ */
+int scheduler_new_jobs_r(scheduler_t *s, const scheduler_job_desc_t *jobs, int count, int time, int *core_ids)
+{
+    SCHEDULER_LOCK( s );
+    STATS_START( start );
+    int assigned = addJobs( s, jobs, count, time, core_ids );
+    STATS_STOP( s, STATS_NEW_JOB, start );
+    SCHEDULER_UNLOCK( s );
+    return assigned;
+}
+
+
+//scheduler_job_finished_r() without the lock
+SCHEME_INLINE int finishJob(scheduler_t *s, scheme_t scheme, int core_id, int job_number, int time)
+{
+    if( scheme == MLFQ )
+    {
+        mlfqBoost( s, time );
+    }
+
+    job_t *old_job = s->current_jobs_on_cores[core_id];
+    assignCore( s, scheme, core_id, NULL );
+
+    int wait_time = time - old_job->arrival_time - old_job->total_time_needed;
+    int turn_around_time = time - old_job->arrival_time;
+
+    s->total_jobs_count++;
+	s->total_wait_time += wait_time;
+	s->total_turn_around_time += turn_around_time;
+    s->total_response_time += old_job->job_response_time;
+    histogramRecord( &s->wait_times, wait_time );
+    histogramRecord( &s->turn_around_times, turn_around_time );
+    histogramRecord( &s->response_times, old_job->job_response_time );
+
+    if( old_job->deadline >= 0 )
+    {
+        int tardiness = time - old_job->deadline;
+
+        s->deadline_jobs++;
+        if( tardiness > 0 )
+        {
+            s->deadline_misses++;
+            s->total_tardiness += tardiness;
+            if( tardiness > s->max_tardiness )
+            {
+                s->max_tardiness = tardiness;
+            }
+        }
+    }
+
+    jobFree( &s->job_pool, old_job );
+
+    // Check for a new job
+    job_t *new_job = nextJob( s, scheme, core_id );
+	if( !new_job )
+	{
+		return -1;
+	}
+    else
+	{
+		if( 0 == new_job->used_time )
+		{
+            // this is the first time we have scheduled it, update response
+            // time as such.
+			new_job->job_response_time = ( time - new_job->arrival_time );
+		}
+        // update its last start time, and place it on a core
+		new_job->last_start_time = time;
+		assignCore( s, scheme, core_id, new_job );
+
+		return new_job->pid;
 	}
 }
 
-int idleCore()
+/**
+  Called when a job has completed execution.
+
+  The core_id, job_number and time parameters are provided for convenience. You may be able to calculate the values with your own data structure.
+  If any job should be scheduled to run on the core free'd up by the
+  finished job, return the job_number of the job that should be scheduled to
+  run on core core_id.
+
+  @param s the scheduler
+  @param core_id the zero-based index of the core where the job was located.
+  @param job_number a globally unique identification number of the job.
+  @param time the current time of the simulator.
+  @return job_number of the job that should be scheduled to run on core core_id
+  @return -1 if core should remain idle.
+ */
+int scheduler_job_finished_r(scheduler_t *s, int core_id, int job_number, int time)
+{
+    SCHEDULER_LOCK( s );
+    STATS_START( start );
+    int job_id = s->paths->job_finished( s, core_id, job_number, time );
+    STATS_STOP( s, STATS_JOB_FINISHED, start );
+    SCHEDULER_UNLOCK( s );
+    return job_id;
+}
+
+
+//scheduler_quantum_expired_r() without the lock
+SCHEME_INLINE int expireQuantum(scheduler_t *s, scheme_t scheme, int core_id, int time)
+{
+	job_t *old = s->current_jobs_on_cores[core_id];
+    STATS_COUNT( s, quantum_expirations );
+    old->used_time += ( time - old->last_start_time );
+
+    if( !jobsWaiting( s, scheme, core_id ) )
+    {
+        // it would only come straight back off the queue, so it carries on
+        if( scheme == MLFQ )
+        {
+            mlfqBoost( s, time );
+            if( jobLevel( s, old ) < s->mlfq_levels - 1 )
+            {
+                setJobLevel( s, old, jobLevel( s, old ) + 1 );
+                priqueue_update( &s->running_jobs, old->victim_handle );
+            }
+        }
+        old->last_start_time = time;
+        if( s->core_penalties )
+        {
+            s->core_penalties[core_id] = 0;  // nothing to charge for staying put
+        }
+        return old->pid;
+    }
+
+    assignCore( s, scheme, core_id, NULL );
+
+    if( scheme == MLFQ )
+    {
+        mlfqBoost( s, time );
+        if( jobLevel( s, old ) < s->mlfq_levels - 1 )
+        {
+            setJobLevel( s, old, jobLevel( s, old ) + 1 );
+        }
+    }
+    queueJob( s, scheme, old );
+
+    job_t *new = nextJob( s, scheme, core_id );
+    if( !new )
+    {
+        return -1;
+    }
+    else
+    {
+        if( 0 == new->used_time )
+        {
+            // this is the first time we have scheduled it, update response
+            // time as such.
+            new->job_response_time = ( time - new->arrival_time );
+        }
+        new->last_start_time = time;
+        assignCore( s, scheme, core_id, new );
+
+        return new->pid;
+    }
+}
+
+/**
+  When the scheme is set to RR or MLFQ, called when the quantum timer has
+  expired on a core. Under MLFQ the job also drops a level.
+
+  If any job should be scheduled to run on the core free'd up by
+  the quantum expiration, return the job_number of the job that should be
+  scheduled to run on core core_id.
+
+  @param s the scheduler
+  @param core_id the zero-based index of the core where the quantum has expired.
+  @param time the current time of the simulator.
+  @return job_number of the job that should be scheduled on core cord_id
+  @return -1 if core should remain idle
+ */
+int scheduler_quantum_expired_r(scheduler_t *s, int core_id, int time)
+{
+    SCHEDULER_LOCK( s );
+    STATS_START( start );
+    int job_id = s->paths->quantum_expired( s, core_id, time );
+    STATS_STOP( s, STATS_QUANTUM_EXPIRED, start );
+    SCHEDULER_UNLOCK( s );
+    return job_id;
+}
+
+
+//SCHEME_PATHS(name, scheme) makes name_paths, a copy of the three event
+//paths with scheme fixed, so each scheme's copy has only its own queue key,
+//victim test and preemption branch left in it. The generic copy reads the
+//scheme from s at every branch instead; a SCHEDULER_GENERIC build
+//(make GENERIC=1) gives it to every scheme, to measure the difference.
+#define SCHEME_PATHS(name, scheme) \
+int addJob_##name(scheduler_t *s, int job_number, int time, int running_time, int priority, int deadline) \
+{ \
+    return addJob( s, scheme, job_number, time, running_time, priority, deadline ); \
+} \
+int finishJob_##name(scheduler_t *s, int core_id, int job_number, int time) \
+{ \
+    return finishJob( s, scheme, core_id, job_number, time ); \
+} \
+int expireQuantum_##name(scheduler_t *s, int core_id, int time) \
+{ \
+    return expireQuantum( s, scheme, core_id, time ); \
+} \
+const scheme_paths_t name##_paths = { addJob_##name, finishJob_##name, expireQuantum_##name };
+
+#ifdef SCHEDULER_GENERIC
+SCHEME_PATHS(generic, s->scheduler_scheme)
+#define PATHS(name) &generic_paths
+#else
+SCHEME_PATHS(FCFS, FCFS)
+SCHEME_PATHS(SJF, SJF)
+SCHEME_PATHS(PSJF, PSJF)
+SCHEME_PATHS(PRI, PRI)
+SCHEME_PATHS(PPRI, PPRI)
+SCHEME_PATHS(RR, RR)
+SCHEME_PATHS(MLFQ, MLFQ)
+SCHEME_PATHS(EDF, EDF)
+SCHEME_PATHS(LLF, LLF)
+#define PATHS(name) &name##_paths
+#endif
+
+const scheme_paths_t *schemePaths(scheme_t scheme)
+{
+    static const scheme_paths_t *const paths[] = {
+        [FCFS] = PATHS(FCFS), [SJF] = PATHS(SJF), [PSJF] = PATHS(PSJF),
+        [PRI] = PATHS(PRI), [PPRI] = PATHS(PPRI), [RR] = PATHS(RR),
+        [MLFQ] = PATHS(MLFQ), [EDF] = PATHS(EDF), [LLF] = PATHS(LLF),
+    };
+    return paths[scheme];
+}
+
+
+/**
+  Returns the average waiting time of all jobs scheduled by your scheduler.
+
+  Assumptions:
+    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param s the scheduler
+  @return the average waiting time of all jobs scheduled.
+ */
+float scheduler_average_waiting_time_r(scheduler_t *s)
+{
+    if(s->total_jobs_count == 0)
+		return 0;
+	else
+		return (double)s->total_wait_time/s->total_jobs_count;
+}
+
+
+
+/**
+  Returns the average turnaround time of all jobs scheduled by your scheduler.
+
+  Assumptions:
+    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param s the scheduler
+  @return the average turnaround time of all jobs scheduled.
+ */
+float scheduler_average_turnaround_time_r(scheduler_t *s)
+{
+    if(s->total_jobs_count == 0)
+    	return 0.0;
+    else
+        return (double)s->total_turn_around_time/s->total_jobs_count;
+
+}
+
+
+/**
+  Returns the average response time of all jobs scheduled by your scheduler.
+
+  Assumptions:
+    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param s the scheduler
+  @return the average response time of all jobs scheduled.
+ */
+float scheduler_average_response_time_r(scheduler_t *s)
+{
+    if(s->total_jobs_count == 0)
+		return 0.0;
+	else
+		return (double)s->total_response_time/s->total_jobs_count;
+}
+
+
+/**
+  Returns a percentile of the waiting times of all jobs scheduled, to within
+  1/128 of its value. 100 gives the longest waiting time exactly.
+
+  Assumptions:
+    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param s the scheduler
+  @param percentile the percentile wanted, from 0 to 100, e.g. 99.9
+  @return the waiting time that percentile percent of jobs did not exceed.
+ */
+int scheduler_waiting_time_percentile_r(scheduler_t *s, double percentile)
+{
+    return histogramPercentile( &s->wait_times, percentile );
+}
+
+
+/**
+  Returns a percentile of the turnaround times of all jobs scheduled, like
+  scheduler_waiting_time_percentile_r().
+  @param s the scheduler
+  @param percentile the percentile wanted, from 0 to 100
+  @return the turnaround time that percentile percent of jobs did not exceed.
+ */
+int scheduler_turnaround_time_percentile_r(scheduler_t *s, double percentile)
+{
+    return histogramPercentile( &s->turn_around_times, percentile );
+}
+
+
+/**
+  Returns a percentile of the response times of all jobs scheduled, like
+  scheduler_waiting_time_percentile_r().
+  @param s the scheduler
+  @param percentile the percentile wanted, from 0 to 100
+  @return the response time that percentile percent of jobs did not exceed.
+ */
+int scheduler_response_time_percentile_r(scheduler_t *s, double percentile)
+{
+    return histogramPercentile( &s->response_times, percentile );
+}
+
+
+/**
+  Returns how many of the jobs scheduled had a deadline.
+
+  Assumptions:
+    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param s the scheduler
+  @return the number of jobs that arrived with a deadline.
+ */
+int scheduler_deadline_jobs_r(scheduler_t *s)
+{
+    return s->deadline_jobs;
+}
+
+
+/**
+  Returns how many jobs finished after their deadline.
+
+  Assumptions:
+    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param s the scheduler
+  @return the number of deadlines missed.
+ */
+int scheduler_deadline_misses_r(scheduler_t *s)
+{
+    return s->deadline_misses;
+}
+
+
+/**
+  Returns the average tardiness, how long after its deadline a job finished
+  (0 for one that met it), over the jobs that had a deadline.
+
+  Assumptions:
+    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param s the scheduler
+  @return the average tardiness of all jobs with a deadline.
+ */
+float scheduler_average_tardiness_r(scheduler_t *s)
+{
+    if(s->deadline_jobs == 0)
+		return 0.0;
+	else
+		return (double)s->total_tardiness/s->deadline_jobs;
+}
+
+
+/**
+  Returns the longest time any job finished after its deadline.
+
+  Assumptions:
+    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+  @param s the scheduler
+  @return the worst tardiness, 0 if every deadline was met.
+ */
+int scheduler_max_tardiness_r(scheduler_t *s)
+{
+    return s->max_tardiness;
+}
+
+
+/*
+  A checkpoint is the scheduler written out as plain integers in host byte
+  order, so it is read back on the same kind of machine that wrote it:
+
+    header    CHECKPOINT_MAGIC, CHECKPOINT_VERSION, the scheme, the number
+              of cores, whether there are run queues and the topology, which
+              the scheduler it is restored into must have too
+    settings  whether jobs are bucketed, the MLFQ levels, quantum, boost
+              interval and next boost, and the steal and migration counts
+    totals    everything the averages, percentiles and deadline figures
+              come from; each histogram goes out as its non-empty buckets
+    jobs      the number of jobs, then one record for each: the running jobs
+              in core order, then the queued ones in the order they will be
+              taken, each with the run queue it is on (-1 for none)
+
+  Restoring a job puts it straight back where it was rather than going
+  through queueJob(), so jobs that tie come back in the same order too.
+  The SCHEDULER_STATS counters are not part of a checkpoint.
+*/
+#define CHECKPOINT_MAGIC   0x53434b50  // "PKCS" in little endian
+#define CHECKPOINT_VERSION 2
+
+#define CHECKPOINT_HEADER 10
+
+void checkpointHeader(scheduler_t *s, int *header)
+{
+  header[0] = CHECKPOINT_MAGIC;
+  header[1] = CHECKPOINT_VERSION;
+  header[2] = s->scheduler_scheme;
+  header[3] = s->core_count;
+  header[4] = ( s->run_queues != NULL );
+  header[5] = ( s->core_penalties != NULL );
+  header[6] = s->cores_per_socket;
+  header[7] = s->sockets_per_node;
+  header[8] = s->socket_penalty;
+  header[9] = s->node_penalty;
+}
+
+typedef struct _checkpoint_io_t
+{
+  FILE *file;
+  int writing;
+  int failed;
+} checkpoint_io_t;
+
+//writes value out, or reads it back in, so that a part of the checkpoint
+//that goes both ways is described once
+void checkpointField(checkpoint_io_t *io, void *value, size_t size)
+{
+  if( io->failed )
+  {
+    return;
+  }
+  if( io->writing ? fwrite( value, size, 1, io->file ) != 1 : fread( value, size, 1, io->file ) != 1 )
+  {
+    io->failed = 1;
+  }
+}
+
+void checkpointHistogram(checkpoint_io_t *io, histogram_t *h)
+{
+  int used = 0;
+
+  checkpointField( io, &h->count, sizeof(h->count) );
+  checkpointField( io, &h->max, sizeof(h->max) );
+
+  if( io->writing )
+  {
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+      used += ( h->counts[i] != 0 );
+    }
+  }
+  checkpointField( io, &used, sizeof(used) );
+  if( used < 0 || used > HISTOGRAM_BUCKETS )
+  {
+    io->failed = 1;
+    return;
+  }
+
+  for(int i = 0, n = 0; n < used && !io->failed; i++)
+  {
+    if( io->writing && h->counts[i] == 0 )
+    {
+      continue;
+    }
+
+    int index = i;
+    checkpointField( io, &index, sizeof(index) );
+    if( index < i || index >= HISTOGRAM_BUCKETS )
+    {
+      io->failed = 1;
+      return;
+    }
+    i = index;
+    checkpointField( io, &h->counts[i], sizeof(h->counts[i]) );
+    n++;
+  }
+}
+
+void checkpointState(checkpoint_io_t *io, scheduler_t *s)
+{
+  checkpointField( io, &s->bucketed, sizeof(s->bucketed) );
+  checkpointField( io, &s->mlfq_levels, sizeof(s->mlfq_levels) );
+  checkpointField( io, &s->mlfq_quantum, sizeof(s->mlfq_quantum) );
+  checkpointField( io, &s->mlfq_boost_interval, sizeof(s->mlfq_boost_interval) );
+  checkpointField( io, &s->mlfq_next_boost, sizeof(s->mlfq_next_boost) );
+  checkpointField( io, &s->steal_count, sizeof(s->steal_count) );
+  checkpointField( io, s->migrations, sizeof(s->migrations) );
+  checkpointField( io, &s->migration_time, sizeof(s->migration_time) );
+
+  checkpointField( io, &s->total_wait_time, sizeof(s->total_wait_time) );
+  checkpointField( io, &s->total_response_time, sizeof(s->total_response_time) );
+  checkpointField( io, &s->total_turn_around_time, sizeof(s->total_turn_around_time) );
+  checkpointField( io, &s->total_jobs_count, sizeof(s->total_jobs_count) );
+  checkpointHistogram( io, &s->wait_times );
+  checkpointHistogram( io, &s->response_times );
+  checkpointHistogram( io, &s->turn_around_times );
+
+  checkpointField( io, &s->deadline_jobs, sizeof(s->deadline_jobs) );
+  checkpointField( io, &s->deadline_misses, sizeof(s->deadline_misses) );
+  checkpointField( io, &s->total_tardiness, sizeof(s->total_tardiness) );
+  checkpointField( io, &s->max_tardiness, sizeof(s->max_tardiness) );
+}
+
+//one job record: its fields, the MLFQ level it is really on, and the run
+//queue it is waiting on
+typedef struct _checkpoint_job_t
+{
+  int pid, arrival_time, priority, used_time, total_time_needed;
+  int last_start_time, job_response_time, deadline;
+  int core_id, home_core, placed_used, level, run_queue;
+} checkpoint_job_t;
+
+void checkpointJob(checkpoint_io_t *io, scheduler_t *s, const job_t *job, int run_queue)
+{
+  checkpoint_job_t record;
+
+  record.pid = job->pid;
+  record.arrival_time = job->arrival_time;
+  record.priority = job->priority;
+  record.used_time = job->used_time;
+  record.total_time_needed = job->total_time_needed;
+  record.last_start_time = job->last_start_time;
+  record.job_response_time = job->job_response_time;
+  record.deadline = job->deadline;
+  record.core_id = job->core_id;
+  record.home_core = job->home_core;
+  record.placed_used = job->placed_used;
+  record.level = jobLevel( s, job );
+  record.run_queue = run_queue;
+  checkpointField( io, &record, sizeof(record) );
+}
+
+//the number of jobs waiting in s, wherever they are queued
+int queuedJobCount(scheduler_t *s)
+{
+  int count = 0;
+
+  if( s->scheduler_scheme == MLFQ || s->bucketed )
+  {
+    for(int bucket = 0; bucket < QUEUE_BUCKETS; bucket++)
+    {
+      for(job_t *job = s->bucket_head[bucket]; job; job = job->next_queued)
+      {
+        count++;
+      }
+    }
+    return count;
+  }
+  if( s->run_queues )
+  {
+    for(int i = 0; i < s->core_count; i++)
+    {
+      count += priqueue_size( &s->run_queues[i].jobs );
+    }
+    return count;
+  }
+  return priqueue_size( &s->job_queue );
+}
+
+//puts a job read back from a checkpoint where it was when it was written
+int restoreJob(scheduler_t *s, const checkpoint_job_t *record)
+{
+  job_t *job = newJob( s, record->pid, record->arrival_time, record->total_time_needed, record->priority, record->deadline );
+  job->used_time = record->used_time;
+  job->last_start_time = record->last_start_time;
+  job->job_response_time = record->job_response_time;
+  job->placed_used = record->placed_used;
+
+  if( s->scheduler_scheme == MLFQ )
+  {
+    if( record->level < 0 || record->level >= s->mlfq_levels )
+    {
+      jobFree( &s->job_pool, job );
+      return 0;
+    }
+    setJobLevel( s, job, record->level );
+  }
+
+  if( record->core_id != -1 )
+  {
+    if( record->core_id < 0 || record->core_id >= s->core_count || s->current_jobs_on_cores[record->core_id] )
+    {
+      jobFree( &s->job_pool, job );
+      return 0;
+    }
+    assignCore( s, s->scheduler_scheme, record->core_id, job );
+    job->home_core = record->home_core;
+    job->placed_used = record->placed_used;
+    return 1;
+  }
+
+  job->home_core = record->home_core;
+  STATS_QUEUED( s, 1 );
+  if( s->scheduler_scheme == MLFQ )
+  {
+    bucketPush( s, job, record->level );
+  }
+  else if( s->run_queues )
+  {
+    if( record->run_queue < 0 || record->run_queue >= s->core_count )
+    {
+      jobFree( &s->job_pool, job );
+      return 0;
+    }
+    run_queue_t *rq = &s->run_queues[record->run_queue];
+    priqueue_offer_key( &rq->jobs, job, queueKey(s, s->scheduler_scheme, job) );
+    runQueueResized( s, rq );
+  }
+  else if( s->bucketed )
+  {
+    int bucket = ( s->scheduler_scheme == FCFS || s->scheduler_scheme == RR ) ? 0 : job->priority;
+    if( bucket < 0 || bucket >= PRIORITY_BUCKETS )
+    {
+      jobFree( &s->job_pool, job );
+      return 0;
+    }
+    bucketPush( s, job, bucket );
+  }
+  else
+  {
+    priqueue_offer_key( &s->job_queue, job, queueKey(s, s->scheduler_scheme, job) );
+  }
+  return 1;
+}
+
+/**
+  Writes everything s knows to out: every job in the system and where it
+  is, the MLFQ settings and the statistics so far. scheduler_restore_r()
+  reads it back into a new scheduler, which then carries on exactly as s
+  would have.
+
+  @param s the scheduler
+  @param out the file to write to, opened for binary writing
+  @return 0 if the checkpoint was written, -1 if writing failed
+ */
+int scheduler_checkpoint_r(scheduler_t *s, FILE *out)
 {
-	for(int i = 0; i< scheduler_ptr->core_count; i++)
-	{
-		if( scheduler_ptr->current_jobs_on_cores[i] == NULL )
-		{
-			return i;
-		}
-	}
-	return -1;
-}
+    checkpoint_io_t io = { out, 1, 0 };
+    int header[CHECKPOINT_HEADER];
 
-int findLongestRemainingJob()
-{
-    int core = -1;
-    int longest_length = 0;
-    int arrival_time = 0;
-    for(int i = 0; i< scheduler_ptr->core_count; i++)
+    checkpointHeader( s, header );
+
+    SCHEDULER_LOCK( s );
+    checkpointField( &io, header, sizeof(header) );
+    checkpointState( &io, s );
+
+    int job_count = s->core_count - s->idle_count + queuedJobCount(s);
+    checkpointField( &io, &job_count, sizeof(job_count) );
+
+    for(int i = 0; i < s->core_count; i++)
     {
-        if( scheduler_ptr->current_jobs_on_cores[i] != NULL )
+        if( s->current_jobs_on_cores[i] )
         {
-            if ( remainingTime( scheduler_ptr->current_jobs_on_cores[i] ) > longest_length )
-            {
-                longest_length = remainingTime( scheduler_ptr->current_jobs_on_cores[i] );
-                arrival_time =  scheduler_ptr->current_jobs_on_cores[i]->arrival_time;
-                core = i;
-            }
-            else if ( remainingTime( scheduler_ptr->current_jobs_on_cores[i] ) == longest_length )
-            {
-                if( scheduler_ptr->current_jobs_on_cores[i]->arrival_time >  arrival_time )
-                {
-                    arrival_time = scheduler_ptr->current_jobs_on_cores[i]->arrival_time;
-                    core = i;
-                }
-            }
+            checkpointJob( &io, s, s->current_jobs_on_cores[i], -1 );
         }
     }
-    return core;
-}
 
-int findWorstPriorityJob()
-{
-    int core = -1;
-    int worst_priority = 0;
-    int arrival_time = 0;
-    for(int i = 0; i< scheduler_ptr->core_count; i++)
+    if( s->scheduler_scheme == MLFQ || s->bucketed )
     {
-        if( scheduler_ptr->current_jobs_on_cores[i] != NULL)
+        for(int bucket = 0; bucket < QUEUE_BUCKETS; bucket++)
         {
-            if( scheduler_ptr->current_jobs_on_cores[i]->priority > worst_priority )
+            for(job_t *job = s->bucket_head[bucket]; job; job = job->next_queued)
             {
-                worst_priority = scheduler_ptr->current_jobs_on_cores[i]->priority;
-                arrival_time = scheduler_ptr->current_jobs_on_cores[i]->arrival_time;
-                core = i;
+                checkpointJob( &io, s, job, -1 );
             }
-            else if ( scheduler_ptr->current_jobs_on_cores[i]->priority == worst_priority )
+        }
+    }
+    else if( s->run_queues )
+    {
+        for(int i = 0; i < s->core_count; i++)
+        {
+            for(int j = 0; j < priqueue_size( &s->run_queues[i].jobs ); j++)
             {
-                if( scheduler_ptr->current_jobs_on_cores[i]->arrival_time >  arrival_time )
-                {
-                    arrival_time = scheduler_ptr->current_jobs_on_cores[i]->arrival_time;
-                    core = i;
-                }
+                checkpointJob( &io, s, priqueue_at( &s->run_queues[i].jobs, j ), i );
             }
-
         }
     }
-    return core;
+    else
+    {
+        for(int j = 0; j < priqueue_size( &s->job_queue ); j++)
+        {
+            checkpointJob( &io, s, priqueue_at( &s->job_queue, j ), -1 );
+        }
+    }
+    SCHEDULER_UNLOCK( s );
+
+    return io.failed ? -1 : 0;
 }
 
 /**
-  Called when a new job arrives.
+  Reads a checkpoint written by scheduler_checkpoint_r() into s, leaving
+  it where the checkpointed scheduler was.
 
-  If multiple cores are idle, the job should be assigned to the core with the
-  lowest id.
-  If the job arriving should be scheduled to run during the next
-  time cycle, return the zero-based index of the core the job should be
-  scheduled on. If another job is already running on the core specified,
-  this will preempt the currently running job.
   Assumptions:
-    - You may assume that every job wil have a unique arrival time.
-
-  @param job_number a globally unique identification number of the job arriving.
-  @param time the current time of the simulator.
-  @param running_time the total number of time units this job will run before it will be finished.
-  @param priority the priority of the job. (The lower the value, the higher the priority.)
-  @return index of core job should be scheduled on
-  @return -1 if no scheduling changes should be made.
-
+    - s is new, made with the same number of cores and scheme as the
+      scheduler that was checkpointed (and scheduler_use_run_queues_r() if
+      that had run queues), and no job has arrived at it yet.
+    - If this fails, s is only fit for scheduler_destroy().
+
+  @param s the scheduler to restore into
+  @param in the file to read from, opened for binary reading
+  @return 0 if s was restored
+  @return -1 if the checkpoint could not be read, or was made by a scheduler unlike s
  */
-int scheduler_new_job(int job_number, int time, int running_time, int priority)
+int scheduler_restore_r(scheduler_t *s, FILE *in)
 {
-    job_t* job = calloc( 1, sizeof(job_t));
-    job->pid = job_number;
-    job->arrival_time = time;
-    job->priority = priority;
-    job->total_time_needed = running_time;
-    job->used_time = 0;
-    job->last_start_time = 0;
-    job->job_response_time = 0;
-    const scheme_t scheme = scheduler_ptr->scheduler_scheme;
-    //either schedule it or place it in the queue;
-
-    int first_core = idleCore();
-    if( first_core != -1 )
+    checkpoint_io_t io = { in, 0, 0 };
+    int header[CHECKPOINT_HEADER], expected[CHECKPOINT_HEADER];
+    int job_count;
+
+    SCHEDULER_LOCK( s );
+    checkpointHeader( s, expected );
+    checkpointField( &io, header, sizeof(header) );
+    if( io.failed || memcmp( header, expected, sizeof(header) ) != 0 )
     {
-        scheduler_ptr->current_jobs_on_cores[first_core] = job;
-        job->last_start_time = time;
-        return first_core;
+        SCHEDULER_UNLOCK( s );
+        return -1;
     }
 
+    checkpointState( &io, s );
+    checkpointField( &io, &job_count, sizeof(job_count) );
+    int can_bucket = !s->run_queues && ( s->scheduler_scheme == FCFS || s->scheduler_scheme == RR ||
+                                         s->scheduler_scheme == PRI || s->scheduler_scheme == PPRI );
+    if( ( s->bucketed && !can_bucket ) || s->mlfq_levels < 0 || s->mlfq_levels > MLFQ_MAX_LEVELS || job_count < 0 )
+    {
+        io.failed = 1;
+    }
 
-    if( scheme == PSJF )
+    for(int i = 0; i < job_count && !io.failed; i++)
     {
-        int longest_job = findLongestRemainingJob();
-        int longest_job_last_remaining_time = remainingTime( scheduler_ptr->current_jobs_on_cores[longest_job] );
-        int longest_job_current_remaining_time = longest_job_last_remaining_time - ( time - scheduler_ptr->current_jobs_on_cores[longest_job]->last_start_time );
+        checkpoint_job_t record;
 
-        if( longest_job_current_remaining_time <=  job->total_time_needed )
-        {
-            // all jobs on cores have lower times, thus higher priority, add this one to queue
-            priqueue_offer ( &scheduler_ptr->job_queue, job );
-            return -1;
-        }
-        else
+        checkpointField( &io, &record, sizeof(record) );
+        if( !io.failed && !restoreJob( s, &record ) )
         {
-            //remove old
-            job_t *old_job = scheduler_ptr->current_jobs_on_cores[longest_job];
-            //log how much time it used
-            old_job->used_time += (time - old_job->last_start_time );
-
-            //replace with new
-            job->last_start_time = time;
-            scheduler_ptr->current_jobs_on_cores[longest_job] = job;
-
-            //push old to queue
-            priqueue_offer ( &scheduler_ptr->job_queue, old_job );
-            return longest_job;
+            io.failed = 1;
         }
     }
-    else if( scheme == PPRI )
-    {
-        int worst_priority_idx =  findWorstPriorityJob();
+    SCHEDULER_UNLOCK( s );
 
-        if( scheduler_ptr->current_jobs_on_cores[worst_priority_idx]->priority <= job->priority )
-        {
-            // all jobs on cores have lower times, thus higher priority, add this one to queue
-            priqueue_offer ( &scheduler_ptr->job_queue, job );
-            return -1;
-        }
-        else
-        {
-            //remove old
-            job_t *old_job = scheduler_ptr->current_jobs_on_cores[worst_priority_idx];
-            //log how much time it used
-            old_job->used_time += (time - old_job->last_start_time );
+    return io.failed ? -1 : 0;
+}
 
-            //replace with new
-            job->last_start_time = time;
-            scheduler_ptr->current_jobs_on_cores[worst_priority_idx] = job;
 
-            //push old to queue
-            priqueue_offer ( &scheduler_ptr->job_queue, old_job );
-            return worst_priority_idx;
-        }
+/**
+  Free any memory associated with a scheduler.
 
+  Assumptions:
+    - This function will be the last function called on s.
+  @param s the scheduler, as returned by scheduler_create()
+*/
+void scheduler_destroy(scheduler_t *s)
+{
+    priqueue_destroy( &s->job_queue );
+    if( s->run_queues )
+    {
+        for(int i = 0; i < s->core_count; i++)
+        {
+            priqueue_destroy( &s->run_queues[i].jobs );
+        }
+        priqueue_destroy( &s->shortest_queues );
+        priqueue_destroy( &s->longest_queues );
+        free( s->run_queues );
     }
-    else if( scheme == RR || scheme == PRI || scheme == FCFS || scheme == SJF )
+    if( tracksVictims(s) )
     {
-    	if( first_core == -1 )
-    	{
-    		priqueue_offer ( &scheduler_ptr->job_queue, job);
-    	}
+        priqueue_destroy( &s->running_jobs );
     }
-    return -1;
+    jobPoolDestroy( &s->job_pool );
+    free( s->batch_jobs );
+    free( s->batch_keys );
+    free( s->core_penalties );
+	free( s->idle_cores );
+	free( s->idle_summary );
+	free( s->current_jobs_on_cores );
+#ifdef SCHEDULER_CONCURRENT
+    pthread_mutex_destroy( &s->lock );
+#endif
+	free( s );
 }
 
 
-/**
-  Called when a job has completed execution.
-
-  The core_id, job_number and time parameters are provided for convenience. You may be able to calculate the values with your own data structure.
-  If any job should be scheduled to run on the core free'd up by the
-  finished job, return the job_number of the job that should be scheduled to
-  run on core core_id.
-
-  @param core_id the zero-based index of the core where the job was located.
-  @param job_number a globally unique identification number of the job.
-  @param time the current time of the simulator.
-  @return job_number of the job that should be scheduled to run on core core_id
-  @return -1 if core should remain idle.
- */
-int scheduler_job_finished(int core_id, int job_number, int time)
+#ifdef SCHEDULER_STATS
+//add the counts of queue q into total
+void addQueueStats(priqueue_stats_t *total, priqueue_t *q)
 {
-    job_t *old_job = scheduler_ptr->current_jobs_on_cores[core_id];
-    scheduler_ptr->current_jobs_on_cores[core_id] = NULL;
-
-    scheduler_ptr->total_jobs_count++;
-	scheduler_ptr->total_wait_time += (time - old_job->arrival_time - old_job->total_time_needed);
-	scheduler_ptr->total_turn_around_time += (time - old_job->arrival_time);
-    scheduler_ptr->total_response_time += old_job->job_response_time;
-
-    free( old_job );
-
-    // Check for a new job
-    job_t *new_job = priqueue_poll( &scheduler_ptr->job_queue );
-	if( !new_job )
-	{
-		return -1;
-	}
-    else
-	{
-		if( 0 == new_job->used_time )
-		{
-            // this is the first time we have scheduled it, update response
-            // time as such.
-			new_job->job_response_time = ( time - new_job->arrival_time );
-		}
-        // place it on a core, and update its last start time
-		scheduler_ptr->current_jobs_on_cores[core_id] = new_job;
-		new_job->last_start_time = time;
-
-		return new_job->pid;
-	}
+    priqueue_stats_t stats;
+
+    priqueue_get_stats( q, &stats );
+    total->offers += stats.offers;
+    total->polls += stats.polls;
+    total->removes += stats.removes;
+    total->updates += stats.updates;
+    total->comparisons += stats.comparisons;
+    total->moves += stats.moves;
+    if( stats.peak_size > total->peak_size )
+    {
+        total->peak_size = stats.peak_size;
+    }
 }
-
+#endif
 
 /**
-  When the scheme is set to RR, called when the quantum timer has expired
-  on a core.
-
-  If any job should be scheduled to run on the core free'd up by
-  the quantum expiration, return the job_number of the job that should be
-  scheduled to run on core core_id.
+  Prints the operation counts and timings of a scheduler built with
+  SCHEDULER_STATS to stderr, with the totals over every priqueue it uses
+  if libpriqueue was built with PRIQUEUE_STATS. Prints nothing otherwise.
 
-  @param core_id the zero-based index of the core where the quantum has expired.
-  @param time the current time of the simulator.
-  @return job_number of the job that should be scheduled on core cord_id
-  @return -1 if core should remain idle
+  @param s the scheduler
  */
-int scheduler_quantum_expired(int core_id, int time)
+void scheduler_dump_stats_r(scheduler_t *s)
 {
-	job_t *old = scheduler_ptr->current_jobs_on_cores[core_id];
-    old->used_time += ( time - old->last_start_time );
-    priqueue_offer( &scheduler_ptr->job_queue, old);
-
-    job_t *new = priqueue_poll( &scheduler_ptr->job_queue );
-    if( !new )
+#ifdef SCHEDULER_STATS
+    static const char *call_names[STATS_CALLS] = { "new_job", "job_finished", "quantum_expired" };
+    priqueue_stats_t queues;
+
+    SCHEDULER_LOCK( s );
+    memset( &queues, 0, sizeof(queues) );
+    addQueueStats( &queues, &s->job_queue );
+    if( tracksVictims(s) )
     {
-        return -1;
+        addQueueStats( &queues, &s->running_jobs );
     }
-    else
+    if( s->run_queues )
     {
-        if( 0 == new->used_time )
+        for(int i = 0; i < s->core_count; i++)
         {
-            // this is the first time we have scheduled it, update response
-            // time as such.
-            new->job_response_time = ( time - new->arrival_time );
+            addQueueStats( &queues, &s->run_queues[i].jobs );
         }
-        new->last_start_time = time;
-        scheduler_ptr->current_jobs_on_cores[core_id] = new;
+        addQueueStats( &queues, &s->shortest_queues );
+        addQueueStats( &queues, &s->longest_queues );
+    }
 
-        return new->pid;
+    fprintf( stderr, "Scheduler statistics:\n" );
+    for(int i = 0; i < STATS_CALLS; i++)
+    {
+        fprintf( stderr, "  %-16s %12llu calls %16llu %s (%.1f per call)\n", call_names[i], s->stats.calls[i],
+                 s->stats.ticks[i], STATS_TICK_UNIT, s->stats.calls[i] ? (double)s->stats.ticks[i] / s->stats.calls[i] : 0.0 );
     }
+    fprintf( stderr, "  preemptions          %llu\n", s->stats.preemptions );
+    fprintf( stderr, "  quantum expirations  %llu\n", s->stats.quantum_expirations );
+    fprintf( stderr, "  context switches     %llu\n", s->stats.context_switches );
+    fprintf( stderr, "  idle-core scans      %llu\n", s->stats.idle_scans );
+    fprintf( stderr, "  jobs stolen          %d\n", s->steal_count );
+    fprintf( stderr, "  peak queued jobs     %d\n", s->stats.peak_queued );
+    fprintf( stderr, "  priqueue offers      %llu\n", queues.offers );
+    fprintf( stderr, "  priqueue polls       %llu\n", queues.polls );
+    fprintf( stderr, "  priqueue removes     %llu\n", queues.removes );
+    fprintf( stderr, "  priqueue updates     %llu\n", queues.updates );
+    fprintf( stderr, "  priqueue comparisons %llu\n", queues.comparisons );
+    fprintf( stderr, "  priqueue moves       %llu\n", queues.moves );
+    fprintf( stderr, "  priqueue peak length %u\n", queues.peak_size );
+    SCHEDULER_UNLOCK( s );
+#endif
 }
 
 
 /**
-  Returns the average waiting time of all jobs scheduled by your scheduler.
+  This function may print out any debugging information you choose. This
+  function will be called by the simulator after every call the simulator
+  makes to your scheduler.
+  In our provided output, we have implemented this function to list the jobs in the order they are to be scheduled. Furthermore, we have also listed the current state of the job (either running on a given core or idle). For example, if we have a non-preemptive algorithm and job(id=4) has began running, job(id=2) arrives with a higher priority, and job(id=1) arrives with a lower priority, the output in our sample output will be:
 
-  Assumptions:
-    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
-  @return the average waiting time of all jobs scheduled.
+    2(-1) 4(0) 1(-1)
+
+  This function is not required and will not be graded. You may leave it
+  blank if you do not find it useful.
+  @param s the scheduler
  */
-float scheduler_average_waiting_time()
+void scheduler_show_queue_r(scheduler_t *s)
 {
-    if(scheduler_ptr->total_jobs_count == 0)
-		return 0;
-	else
-		return (float)scheduler_ptr->total_wait_time/(float)scheduler_ptr->total_jobs_count;
+
 }
 
 
+/*
+  The single-instance interface. These run on one scheduler, made by
+  scheduler_start_up() and kept in scheduler_ptr, and are otherwise the
+  same as the scheduler_*_r() calls above.
+*/
 
 /**
-  Returns the average turnaround time of all jobs scheduled by your scheduler.
+  Initalizes the scheduler.
 
   Assumptions:
-    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
-  @return the average turnaround time of all jobs scheduled.
- */
-float scheduler_average_turnaround_time()
+    - You may assume this will be the first scheduler function called.
+    - You may assume this function will be called once once.
+    - You may assume that cores is a positive, non-zero number.
+    - You may assume that scheme is a valid scheduling scheme.
+
+  @param cores the number of cores that is available by the scheduler. These cores will be known as core(id=0), core(id=1), ..., core(id=cores-1).
+  @param scheme  the scheduling scheme that should be used. This value will be one of the enum values of scheme_t
+*/
+void scheduler_start_up(int cores, scheme_t scheme)
 {
-    if(scheduler_ptr->total_jobs_count == 0)
-    	return 0.0;
-    else
-        return (float)scheduler_ptr->total_turn_around_time/(float)scheduler_ptr->total_jobs_count;
+    scheduler_ptr = scheduler_create( cores, scheme );
+}
 
+/**
+  Initalizes the scheduler like scheduler_start_up(), with a job pool sized
+  for job_capacity jobs. See scheduler_create_with_capacity().
+*/
+void scheduler_start_up_with_capacity(int cores, scheme_t scheme, int job_capacity)
+{
+    scheduler_ptr = scheduler_create_with_capacity( cores, scheme, job_capacity );
 }
 
+/** See scheduler_new_job_r(). */
+int scheduler_new_job(int job_number, int time, int running_time, int priority)
+{
+    return scheduler_new_job_r( scheduler_ptr, job_number, time, running_time, priority );
+}
 
-/**
-  Returns the average response time of all jobs scheduled by your scheduler.
+/** See scheduler_new_jobs_r(). */
+int scheduler_new_jobs(const scheduler_job_desc_t *jobs, int count, int time, int *core_ids)
+{
+    return scheduler_new_jobs_r( scheduler_ptr, jobs, count, time, core_ids );
+}
 
-  Assumptions:
-    - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
-  @return the average response time of all jobs scheduled.
- */
-float scheduler_average_response_time()
+/** See scheduler_job_finished_r(). */
+int scheduler_job_finished(int core_id, int job_number, int time)
 {
-    if(scheduler_ptr->total_jobs_count == 0)
-		return 0.0;
-	else
-		return (float)scheduler_ptr->total_response_time/(float)scheduler_ptr->total_jobs_count;
+    return scheduler_job_finished_r( scheduler_ptr, core_id, job_number, time );
+}
+
+/** See scheduler_quantum_expired_r(). */
+int scheduler_quantum_expired(int core_id, int time)
+{
+    return scheduler_quantum_expired_r( scheduler_ptr, core_id, time );
+}
+
+/** See scheduler_average_waiting_time_r(). */
+float scheduler_average_waiting_time()
+{
+    return scheduler_average_waiting_time_r( scheduler_ptr );
+}
+
+/** See scheduler_average_turnaround_time_r(). */
+float scheduler_average_turnaround_time()
+{
+    return scheduler_average_turnaround_time_r( scheduler_ptr );
 }
 
+/** See scheduler_average_response_time_r(). */
+float scheduler_average_response_time()
+{
+    return scheduler_average_response_time_r( scheduler_ptr );
+}
 
 /**
   Free any memory associated with your scheduler.
@@ -443,24 +2456,30 @@ float scheduler_average_response_time()
 */
 void scheduler_clean_up()
 {
-    priqueue_destroy( &scheduler_ptr->job_queue );
-	free( scheduler_ptr->current_jobs_on_cores );
-	free( scheduler_ptr );
+    scheduler_destroy( scheduler_ptr );
+    scheduler_ptr = NULL;
 }
 
+/** See scheduler_checkpoint_r(). */
+int scheduler_checkpoint(FILE *out)
+{
+    return scheduler_checkpoint_r( scheduler_ptr, out );
+}
 
-/**
-  This function may print out any debugging information you choose. This
-  function will be called by the simulator after every call the simulator
-  makes to your scheduler.
-  In our provided output, we have implemented this function to list the jobs in the order they are to be scheduled. Furthermore, we have also listed the current state of the job (either running on a given core or idle). For example, if we have a non-preemptive algorithm and job(id=4) has began running, job(id=2) arrives with a higher priority, and job(id=1) arrives with a lower priority, the output in our sample output will be:
+/** See scheduler_restore_r(). */
+int scheduler_restore(FILE *in)
+{
+    return scheduler_restore_r( scheduler_ptr, in );
+}
 
-    2(-1) 4(0) 1(-1)
+/** See scheduler_dump_stats_r(). */
+void scheduler_dump_stats()
+{
+    scheduler_dump_stats_r( scheduler_ptr );
+}
 
-  This function is not required and will not be graded. You may leave it
-  blank if you do not find it useful.
- */
+/** See scheduler_show_queue_r(). */
 void scheduler_show_queue()
 {
-
+    scheduler_show_queue_r( scheduler_ptr );
 }
@@ -4,20 +4,109 @@
 #ifndef LIBSCHEDULER_H_
 #define LIBSCHEDULER_H_
 
+#include <stdio.h>
+
 /**
   Constants which represent the different scheduling algorithms
 */
-typedef enum {FCFS = 0, SJF, PSJF, PRI, PPRI, RR} scheme_t;
+typedef enum {FCFS = 0, SJF, PSJF, PRI, PPRI, RR, MLFQ, EDF, LLF} scheme_t;
+
+/**
+  MLFQ limits and the settings a new MLFQ scheduler starts out with. See
+  scheduler_set_mlfq_r().
+*/
+#define MLFQ_MAX_LEVELS      64
+#define MLFQ_DEFAULT_LEVELS  3
+#define MLFQ_DEFAULT_QUANTUM 2
+#define MLFQ_DEFAULT_BOOST   100
+
+/**
+  PRI and PPRI queue jobs with priorities from 0 to PRIORITY_BUCKETS - 1
+  in constant time, in a bucket per priority. The first job outside that
+  range moves the scheduler over to its general queue for good.
+*/
+#define PRIORITY_BUCKETS 64
+
+/**
+  How far a job moved when it was put on a core other than the one it last
+  ran on: to another core on the same socket, to another socket on the
+  same node, or to another node. See scheduler_set_topology_r().
+*/
+typedef enum {MIGRATION_CORE = 0, MIGRATION_SOCKET, MIGRATION_NODE, MIGRATION_KINDS} migration_t;
+
+/**
+  A scheduler instance. Each one has its own queue, cores and statistics,
+  so several can run side by side, e.g. one per thread. Built with
+  SCHEDULER_CONCURRENT (make CONCURRENT=1), one scheduler may also be
+  shared, e.g. by threads submitting jobs and threads finishing them.
+*/
+typedef struct _scheduler_t scheduler_t;
+
+/**
+  One of a batch of jobs arriving together, for scheduler_new_jobs_r().
+  deadline is -1 for a job without one.
+*/
+typedef struct _scheduler_job_desc_t
+{
+  int job_number;
+  int running_time;
+  int priority;
+  int deadline;
+} scheduler_job_desc_t;
+
+scheduler_t *scheduler_create              (int cores, scheme_t scheme);
+scheduler_t *scheduler_create_with_capacity(int cores, scheme_t scheme, int job_capacity);
+int   scheduler_new_job_r                (scheduler_t *s, int job_number, int time, int running_time, int priority);
+int   scheduler_new_deadline_job_r       (scheduler_t *s, int job_number, int time, int running_time, int priority, int deadline);
+int   scheduler_new_jobs_r               (scheduler_t *s, const scheduler_job_desc_t *jobs, int count, int time, int *core_ids);
+int   scheduler_job_finished_r           (scheduler_t *s, int core_id, int job_number, int time);
+int   scheduler_quantum_expired_r        (scheduler_t *s, int core_id, int time);
+float scheduler_average_turnaround_time_r(scheduler_t *s);
+float scheduler_average_waiting_time_r   (scheduler_t *s);
+float scheduler_average_response_time_r  (scheduler_t *s);
+int   scheduler_waiting_time_percentile_r   (scheduler_t *s, double percentile);
+int   scheduler_turnaround_time_percentile_r(scheduler_t *s, double percentile);
+int   scheduler_response_time_percentile_r  (scheduler_t *s, double percentile);
+int   scheduler_deadline_jobs_r          (scheduler_t *s);
+int   scheduler_deadline_misses_r        (scheduler_t *s);
+float scheduler_average_tardiness_r      (scheduler_t *s);
+int   scheduler_max_tardiness_r          (scheduler_t *s);
+void  scheduler_destroy                  (scheduler_t *s);
+
+int   scheduler_set_mlfq_r               (scheduler_t *s, int levels, int base_quantum, int boost_interval);
+int   scheduler_core_quantum_r           (scheduler_t *s, int core_id);
+void  scheduler_use_run_queues_r         (scheduler_t *s);
+int   scheduler_steal_count_r            (scheduler_t *s);
+void  scheduler_set_topology_r           (scheduler_t *s, int cores_per_socket, int sockets_per_node, int socket_penalty, int node_penalty);
+int   scheduler_core_penalty_r           (scheduler_t *s, int core_id);
+int   scheduler_migrations_r             (scheduler_t *s, migration_t kind);
+int   scheduler_migration_time_r         (scheduler_t *s);
+
+int   scheduler_checkpoint_r             (scheduler_t *s, FILE *out);
+int   scheduler_restore_r                (scheduler_t *s, FILE *in);
+
+void  scheduler_dump_stats_r             (scheduler_t *s);
+void  scheduler_show_queue_r             (scheduler_t *s);
+
+/*
+  The original single-instance interface: the same calls, run on one
+  scheduler made by scheduler_start_up().
+*/
 
 void  scheduler_start_up               (int cores, scheme_t scheme);
+void  scheduler_start_up_with_capacity (int cores, scheme_t scheme, int job_capacity);
 int   scheduler_new_job                (int job_number, int time, int running_time, int priority);
+int   scheduler_new_jobs               (const scheduler_job_desc_t *jobs, int count, int time, int *core_ids);
 int   scheduler_job_finished           (int core_id, int job_number, int time);
 int   scheduler_quantum_expired        (int core_id, int time);
 float scheduler_average_turnaround_time();
 float scheduler_average_waiting_time   ();
 float scheduler_average_response_time  ();
+int   scheduler_checkpoint             (FILE *out);
+int   scheduler_restore                (FILE *in);
 void  scheduler_clean_up               ();
 
+void  scheduler_dump_stats             ();
 void  scheduler_show_queue             ();
 
 #endif /* LIBSCHEDULER_H_ */
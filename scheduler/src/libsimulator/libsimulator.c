@@ -0,0 +1,1663 @@
+/*
+ * CS 241
+ * The University of Illinois
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "libsimulator.h"
+#include "libpriqueue/libpriqueue.h"
+
+
+/*
+ * Parse the number at the start of the field at *p the way atoi() would,
+ * and step *p past the comma that ends the field.  Returns 1, 0 if there
+ * is no field left before end, or -1 if the number does not fit in an int.
+ */
+int parse_field(char **p, char *end, int *value)
+{
+	char *c = *p;
+	int negative = 0, number = 0;
+
+	if (c == end || *c == ',')
+		return 0;
+
+	while (c < end && (*c == ' ' || *c == '\t'))
+		c++;
+	if (c < end && (*c == '-' || *c == '+'))
+		negative = (*c++ == '-');
+	while (c < end && *c >= '0' && *c <= '9')
+	{
+		int digit = *c++ - '0';
+		if (number > (INT_MAX - digit) / 10)
+			return -1;
+		number = number * 10 + digit;
+	}
+
+	while (c < end && *c != ',')
+		c++;
+	*p = (c < end) ? c + 1 : c;
+
+	*value = negative ? -number : number;
+	return 1;
+}
+
+/*
+ * Point *line at the next line in the reader, without its newline.
+ * Returns 1, 0 at the end, or -1 after printing that a line too long for
+ * memory was left unread.
+ */
+int reader_line(simulator_reader_t *reader, char **line, char **line_end)
+{
+	char *newline;
+
+	while ((newline = memchr(reader->buffer + reader->start, '\n', reader->end - reader->start)) == NULL && !reader->eof)
+	{
+		// No whole line is buffered: make room and read some more.
+		if (reader->start > 0)
+		{
+			memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+			reader->end -= reader->start;
+			reader->start = 0;
+		}
+		else if (reader->end == reader->size)
+		{
+			char *buffer = (reader->size <= INT_MAX / 2) ? realloc(reader->buffer, reader->size * 2) : NULL;
+			if (buffer == NULL)
+			{
+				fprintf(stderr, "Out of memory.\n");
+				return -1;
+			}
+
+			reader->buffer = buffer;
+			reader->size *= 2;
+		}
+
+		size_t count = fread(reader->buffer + reader->end, 1, reader->size - reader->end, reader->file);
+		reader->end += count;
+		if (count == 0)
+			reader->eof = 1;
+	}
+
+	if (reader->start == reader->end)
+		return 0;
+
+	*line = reader->buffer + reader->start;
+	*line_end = (newline != NULL) ? newline : reader->buffer + reader->end;
+	reader->start = *line_end - reader->buffer + (newline != NULL);
+	return 1;
+}
+
+/*
+ * Map file as a binary trace if it starts with TRACE_MAGIC.  Returns 1 if
+ * it is a trace, 0 if it is not, or -1 after printing that it is a broken
+ * one.
+ */
+int reader_map(simulator_reader_t *reader, const char *file_name)
+{
+	struct stat info;
+	trace_header_t header;
+
+	size_t count = fread(&header, 1, sizeof(header), reader->file);
+
+	if (count < 8 || memcmp(header.magic, TRACE_MAGIC, 8) != 0)
+	{
+		rewind(reader->file);
+		return 0;
+	}
+
+	size_t record_size = sizeof(trace_record_t) + ((header.flags & TRACE_DEADLINES) ? sizeof(int32_t) : 0);
+
+	// Bound job_count by the file size before multiplying, so a forged count cannot wrap around
+	if (count < sizeof(header) || header.version != TRACE_VERSION || fstat(fileno(reader->file), &info) != 0 ||
+			(uint64_t)info.st_size < sizeof(header) || header.job_count > INT_MAX ||
+			header.job_count > ((uint64_t)info.st_size - sizeof(header)) / record_size ||
+			(uint64_t)info.st_size != sizeof(header) + header.job_count * record_size)
+	{
+		fprintf(stderr, "Illegal trace file \"%s\".\n", file_name);
+		return -1;
+	}
+
+	reader->map_size = info.st_size;
+	reader->map = mmap(NULL, reader->map_size, PROT_READ, MAP_PRIVATE, fileno(reader->file), 0);
+	if (reader->map == MAP_FAILED)
+	{
+		reader->map = NULL;
+		fprintf(stderr, "Unable to map file \"%s\".\n", file_name);
+		return -1;
+	}
+	madvise(reader->map, reader->map_size, MADV_SEQUENTIAL);
+
+	reader->records = (const trace_record_t *)((const char *)reader->map + sizeof(header));
+	reader->record_count = header.job_count;
+	if (header.flags & TRACE_DEADLINES)
+		reader->deadlines = (const int32_t *)(reader->records + reader->record_count);
+	reader->delta_arrivals = (header.flags & TRACE_DELTA_ARRIVALS) != 0;
+	return 1;
+}
+
+/*
+ * Open a job file, either a CSV file, whose header line is skipped, or a
+ * binary trace.  Returns 0, or 2 after printing why the file could not be
+ * opened.
+ */
+int reader_open(simulator_reader_t *reader, const char *file_name)
+{
+	char *line, *line_end;
+
+	reader->file = fopen(file_name, "r");
+	if (reader->file == NULL)
+	{
+		fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
+		return 2;
+	}
+
+	reader->buffer = NULL;
+	reader->start = reader->end = 0;
+	reader->eof = 0;
+	reader->jobs_read = 0;
+	reader->map = NULL;
+	reader->records = NULL;
+	reader->deadlines = NULL;
+	reader->last_arrival = 0;
+
+	switch (reader_map(reader, file_name))
+	{
+		case 1:
+			return 0;
+		case -1:
+			fclose(reader->file);
+			return 2;
+	}
+
+	reader->size = 1 << 16;
+	reader->buffer = malloc(reader->size);
+	if (reader->buffer == NULL)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		fclose(reader->file);
+		return 2;
+	}
+
+	// Ignore the first (header) line
+	if (reader_line(reader, &line, &line_end) < 0)
+	{
+		reader_close(reader);
+		return 2;
+	}
+	return 0;
+}
+
+/*
+ * Read the next job into *job, numbering jobs by their line in the file.
+ * A CSV line may have a fourth column, the job's deadline.
+ * Returns 1, 0 at the end of the file, or -1 after printing that the line
+ * is malformed.
+ */
+int reader_next(simulator_reader_t *reader, simulator_job_list_t *job)
+{
+	if (reader->records != NULL)
+	{
+		if (reader->jobs_read == reader->record_count)
+			return 0;
+
+		const trace_record_t *record = &reader->records[reader->jobs_read];
+		job->arrival_time = record->arrival_time;
+		job->run_time = record->run_time;
+		job->priority = record->priority;
+		job->deadline = (reader->deadlines != NULL) ? reader->deadlines[reader->jobs_read] : -1;
+
+		if (reader->delta_arrivals)
+			job->arrival_time = reader->last_arrival += record->arrival_time;
+	}
+	else
+	{
+		char *line, *line_end;
+		int result = reader_line(reader, &line, &line_end);
+
+		if (result <= 0)
+			return result;
+
+		// The deadline column is optional.
+		if (parse_field(&line, line_end, &job->arrival_time) <= 0 ||
+				parse_field(&line, line_end, &job->run_time) <= 0 ||
+				parse_field(&line, line_end, &job->priority) <= 0 ||
+				(result = parse_field(&line, line_end, &job->deadline)) < 0)
+		{
+			fprintf(stderr, "Illegal file format.\n");
+			return -1;
+		}
+		if (result == 0)
+			job->deadline = -1;
+	}
+
+	if (job->deadline < 0)
+		job->deadline = -1;
+
+	// A job arriving before time 0 would hold up the admission
+	// cursor forever, and one that needs no time never finishes.
+	if (job->arrival_time < 0 || job->run_time <= 0)
+	{
+		fprintf(stderr, "Illegal file format.\n");
+		return -1;
+	}
+
+	job->job_id = reader->jobs_read++;
+	job->core_id = -1;
+	job->arrived = 0;
+	job->finished = 0;
+	return 1;
+}
+
+void reader_close(simulator_reader_t *reader)
+{
+	if (reader->map != NULL)
+		munmap(reader->map, reader->map_size);
+	fclose(reader->file);
+	free(reader->buffer);
+}
+
+/*
+ * Read a job file into a job list sorted by arrival time, along with the
+ * position[] map from each job_id back to its place in the list.
+ * Returns 0, or 2 after printing why the file could not be loaded.
+ */
+int simulator_load_jobs(const char *file_name, simulator_job_list_t **jobs_out, int **position_out, int *job_count)
+{
+	simulator_reader_t reader;
+
+	int status = reader_open(&reader, file_name);
+	if (status != 0)
+		return status;
+
+	int job_id = 0, i, result;
+	long jobs_ct = (reader.records != NULL) ? reader.record_count + 1 : 10;
+	simulator_job_list_t* jobs = malloc(jobs_ct * sizeof(simulator_job_list_t));
+	if (!jobs)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		reader_close(&reader);
+		return 2;
+	}
+
+	while (1)
+	{
+		if (job_id == jobs_ct)
+		{
+			// Job ids are ints, so stop well before doubling could pass INT_MAX
+			if (jobs_ct > INT_MAX / 2)
+			{
+				fprintf(stderr, "Illegal trace file \"%s\": more than %ld jobs.\n", file_name, jobs_ct);
+				free(jobs);
+				reader_close(&reader);
+				return 2;
+			}
+
+			jobs_ct *= 2;
+			jobs = realloc(jobs, jobs_ct * sizeof(simulator_job_list_t));
+
+			if (!jobs)
+			{
+				fprintf(stderr, "Out of memory.\n");
+				return 2;
+			}
+		}
+
+		if ((result = reader_next(&reader, &jobs[job_id])) <= 0)
+			break;
+		job_id++;
+	}
+
+	reader_close(&reader);
+
+	if (result < 0)
+	{
+		free(jobs);
+		return 2;
+	}
+
+	int *position = malloc(((size_t)job_id + 1) * sizeof(int));
+
+	qsort(jobs, job_id, sizeof(simulator_job_list_t), compare_arrivals);
+	for (i = 0; i < job_id; i++)
+		position[jobs[i].job_id] = i;
+
+	*jobs_out = jobs;
+	*position_out = position;
+	*job_count = job_id;
+	return 0;
+}
+
+int compare_arrivals(const void *a, const void *b)
+{
+	const simulator_job_list_t *left = a, *right = b;
+
+	if (left->arrival_time != right->arrival_time)
+		return (left->arrival_time < right->arrival_time) ? -1 : 1;
+	return left->job_id - right->job_id;
+}
+
+int set_active_job(int job_id, int core_id, simulator_job_list_t *jobs, int *position, int job_count)
+{
+	if (job_id >= 0 && job_id < job_count)
+	{
+		simulator_job_list_t *job = &jobs[position[job_id]];
+
+		if (job->arrived && !job->finished)
+		{
+			job->core_id = core_id;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void scan_order_init(simulator_scan_order_t *order, int job_count)
+{
+	int i;
+
+	order->slot = malloc((job_count + 1) * sizeof(int));
+	order->job = malloc((job_count + 1) * sizeof(int));
+	order->count = job_count;
+
+	for (i = 0; i < job_count; i++)
+		order->slot[i] = order->job[i] = i;
+}
+
+void scan_order_destroy(simulator_scan_order_t *order)
+{
+	free(order->slot);
+	free(order->job);
+}
+
+// Delete a finished job the way the old list did.
+void scan_order_remove(simulator_scan_order_t *order, int job_id)
+{
+	int slot = order->slot[job_id];
+	int last = order->job[--order->count];
+
+	order->job[slot] = last;
+	order->slot[last] = slot;
+}
+
+// Insert job_id into ids[0..count), which is kept in scan order.
+void scan_order_insert(simulator_scan_order_t *order, int *ids, int count, int job_id)
+{
+	while (count > 0 && order->slot[ids[count - 1]] > order->slot[job_id])
+	{
+		ids[count] = ids[count - 1];
+		count--;
+	}
+	ids[count] = job_id;
+}
+
+/*
+ * Take the next of ids[0..*count) to finish, as the old list walk would
+ * have found it, and delete it from the list.  The walk went up the list
+ * and rechecked each hole after the last job moved in, so the next one is
+ * always the one in the lowest slot, and the job moving into a hole keeps
+ * its place in the sorted ids by taking the hole's slot.
+ */
+int scan_order_next_finished(simulator_scan_order_t *order, int *ids, int *count)
+{
+	int job_id = ids[0];
+	int last = order->job[order->count - 1];
+	int i, k;
+
+	for (i = 1; i < *count; i++)
+		ids[i - 1] = ids[i];
+	(*count)--;
+
+	scan_order_remove(order, job_id);
+
+	// If the job that moved is also finishing, it is now the first.
+	for (i = 0; i < *count; i++)
+	{
+		if (ids[i] == last)
+		{
+			for (k = i; k > 0; k--)
+				ids[k] = ids[k - 1];
+			ids[0] = last;
+			break;
+		}
+	}
+
+	return job_id;
+}
+
+void print_available_jobs(simulator_job_list_t *jobs, int job_count)
+{
+	printf("Active jobs are: ");
+
+	int i, first = 1;
+	for (i = 0; i < job_count; i++)
+	{
+		if (jobs[i].arrived && !jobs[i].finished)
+		{
+			if (first)
+			{
+				printf("%d", jobs[i].job_id);
+				first = 0;
+			}
+			else
+				printf(", %d", jobs[i].job_id);
+		}
+	}
+
+	if (!first)
+		printf("\n");
+}
+
+void print_available_cores(int cores)
+{
+	printf("Active cores are: ");
+
+	int i;
+	for (i = 0; i < cores; i++)
+	{
+		if (i == cores - 1)
+			printf("%d\n", i);
+		else
+			printf("%d, ", i);
+	}
+}
+
+
+// Lowercase scheme names, indexed by scheme_t.
+const char *scheme_names[] = { "fcfs", "sjf", "psjf", "pri", "ppri", "rr", "mlfq", "edf", "llf" };
+
+// Whether the scheme runs jobs for a quantum at a time.
+int scheme_has_quantum(int scheme)
+{
+	return scheme == RR || scheme == MLFQ;
+}
+
+/*
+ * The quantum to start core_id's clock at, now that the scheduler has given
+ * it its next job.  RR always uses the one quantum; under MLFQ it depends on
+ * the level of the job on the core.
+ */
+int core_quantum(scheduler_t *s, int scheme, int quantum, int core_id)
+{
+	if (scheme == MLFQ)
+	{
+		int level_quantum = scheduler_core_quantum_r(s, core_id);
+		if (level_quantum > 0)
+			return level_quantum;
+	}
+	return quantum;
+}
+
+/*
+ * Parse a list like "1,2,8-16" of positive numbers, appending them to
+ * *values.  Returns 0 if the list is malformed.
+ */
+int parse_number_list(const char *list, int **values, int *count)
+{
+	const char *p = list;
+
+	while (*p)
+	{
+		char *end;
+		long low = strtol(p, &end, 10), high = low;
+
+		if (end == p || low <= 0)
+			return 0;
+
+		if (*end == '-')
+		{
+			p = end + 1;
+			high = strtol(p, &end, 10);
+			if (end == p || high < low)
+				return 0;
+		}
+
+		for (; low <= high; low++)
+		{
+			*values = realloc(*values, (*count + 1) * sizeof(int));
+			(*values)[(*count)++] = low;
+		}
+
+		if (*end == ',')
+			end++;
+		else if (*end != '\0')
+			return 0;
+		p = end;
+	}
+
+	return 1;
+}
+
+/*
+ * Parse a list of schemes into parallel scheme and quantum arrays.  A
+ * quantum of 0 on RR or MLFQ means it takes every -q quantum.  Returns 0 on an
+ * unknown scheme.
+ */
+int parse_scheme_list(char *list, int **schemes, int **quanta, int *count)
+{
+	char *name;
+
+	for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ","))
+	{
+		int scheme = -1, quantum = 0;
+
+		if (strcasecmp(name, "FCFS") == 0) { scheme = FCFS; }
+		else if (strcasecmp(name, "SJF") == 0) { scheme = SJF; }
+		else if (strcasecmp(name, "PSJF") == 0) { scheme = PSJF; }
+		else if (strcasecmp(name, "PRI") == 0) { scheme = PRI; }
+		else if (strcasecmp(name, "PPRI") == 0) { scheme = PPRI; }
+		else if (strcasecmp(name, "EDF") == 0) { scheme = EDF; }
+		else if (strcasecmp(name, "LLF") == 0) { scheme = LLF; }
+		else if (strncasecmp(name, "MLFQ", 4) == 0)
+		{
+			scheme = MLFQ;
+			if (name[4] != '\0' && (quantum = atoi(name + 4)) <= 0)
+				return 0;
+		}
+		else if (strncasecmp(name, "RR", 2) == 0)
+		{
+			scheme = RR;
+			if (name[2] != '\0' && (quantum = atoi(name + 2)) <= 0)
+				return 0;
+		}
+
+		if (scheme == -1)
+			return 0;
+
+		*schemes = realloc(*schemes, (*count + 1) * sizeof(int));
+		*quanta = realloc(*quanta, (*count + 1) * sizeof(int));
+		(*schemes)[*count] = scheme;
+		(*quanta)[*count] = quantum;
+		(*count)++;
+	}
+
+	return 1;
+}
+
+void job_time_string(char *time_string, int job_id)
+{
+	if (job_id < 10)
+		sprintf(time_string, "%d", job_id);
+	else if (job_id < 10 + 26)
+		sprintf(time_string, "%c", job_id - 10 + 'a');
+	else if (job_id < 10 + 26 + 26)
+		sprintf(time_string, "%c", job_id - 10 - 26 + 'A');
+	else
+		snprintf(time_string, 16, "(%d)", job_id);
+}
+
+
+void diagram_init(simulator_diagram_t *diagram)
+{
+	diagram->segments = NULL;
+	diagram->count = 0;
+	diagram->capacity = 0;
+	diagram->end = 0;
+}
+
+// Extend the diagram by length time units of job_id, -1 for idle.
+int diagram_append(simulator_diagram_t *diagram, int job_id, int length)
+{
+	if (length <= 0)
+		return 1;
+
+	if (diagram->count > 0 && diagram->segments[diagram->count - 1].job_id == job_id)
+	{
+		diagram->segments[diagram->count - 1].length += length;
+		diagram->end += length;
+		return 1;
+	}
+
+	if (diagram->count == diagram->capacity)
+	{
+		int capacity = diagram->capacity ? diagram->capacity * 2 : 16;
+		simulator_segment_t *segments = realloc(diagram->segments, capacity * sizeof(simulator_segment_t));
+
+		if (segments == NULL)
+			return 0;
+
+		diagram->segments = segments;
+		diagram->capacity = capacity;
+	}
+
+	simulator_segment_t *segment = &diagram->segments[diagram->count++];
+	segment->job_id = job_id;
+	segment->start = diagram->end;
+	segment->length = length;
+	diagram->end += length;
+	return 1;
+}
+
+// Print the diagram as text, one job_time_string() (or '-') per time unit.
+void diagram_print(simulator_diagram_t *diagram)
+{
+	char time_string[16];
+	int i, t;
+
+	for (i = 0; i < diagram->count; i++)
+	{
+		simulator_segment_t *segment = &diagram->segments[i];
+
+		if (segment->job_id == -1)
+			strcpy(time_string, "-");
+		else
+			job_time_string(time_string, segment->job_id);
+
+		for (t = 0; t < segment->length; t++)
+			fputs(time_string, stdout);
+	}
+}
+
+void diagram_destroy(simulator_diagram_t *diagram)
+{
+	free(diagram->segments);
+}
+
+
+const char *event_names[] = { "arrive", "run", "preempt", "expire", "finish" };
+
+#define EVENT_LOG_BUFFER (1 << 20)
+#define EVENT_LOG_LINE 128  // room for the longest text record
+
+int event_log_flush(simulator_event_log_t *log)
+{
+	if (log->used > 0 && !log->failed && fwrite(log->buffer, 1, log->used, log->file) != (size_t)log->used)
+	{
+		fprintf(stderr, "Unable to write file \"%s\".\n", log->file_name);
+		log->failed = 1;
+	}
+	log->used = 0;
+	return !log->failed;
+}
+
+int event_log_open(simulator_event_log_t *log, const char *file_name, int format)
+{
+	log->file = fopen(file_name, (format == EVENT_LOG_BINARY) ? "wb" : "w");
+	if (log->file == NULL)
+	{
+		fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
+		return 2;
+	}
+
+	log->file_name = file_name;
+	log->format = format;
+	log->size = EVENT_LOG_BUFFER;
+	log->buffer = malloc(log->size);
+	log->used = 0;
+	log->failed = 0;
+
+	if (format == EVENT_LOG_BINARY)
+	{
+		event_log_header_t header;
+
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, EVENT_LOG_MAGIC, 8);
+		header.version = EVENT_LOG_VERSION;
+		header.record_size = sizeof(event_log_record_t);
+		memcpy(log->buffer, &header, sizeof(header));
+		log->used = sizeof(header);
+	}
+	else if (format == EVENT_LOG_CSV)
+		log->used = sprintf(log->buffer, "time,event,job_id,core_id,queue_length\n");
+
+	return 0;
+}
+
+void event_log_write(simulator_event_log_t *log, int time, int event, int job_id, int core_id, int queue_length)
+{
+	if (log->size - log->used < EVENT_LOG_LINE)
+		event_log_flush(log);
+
+	char *end = log->buffer + log->used;
+
+	switch (log->format)
+	{
+		case EVENT_LOG_CSV:
+			log->used += sprintf(end, "%d,%s,%d,%d,%d\n", time, event_names[event], job_id, core_id, queue_length);
+			break;
+
+		case EVENT_LOG_NDJSON:
+			log->used += sprintf(end, "{\"time\":%d,\"event\":\"%s\",\"job_id\":%d,\"core_id\":%d,\"queue_length\":%d}\n",
+			                     time, event_names[event], job_id, core_id, queue_length);
+			break;
+
+		default:
+		{
+			event_log_record_t record = { time, event, job_id, core_id, queue_length };
+
+			memcpy(end, &record, sizeof(record));
+			log->used += sizeof(record);
+			break;
+		}
+	}
+}
+
+// Write out what is left and close the log.  Returns 0, or 2 if any of it
+// could not be written.
+int event_log_close(simulator_event_log_t *log)
+{
+	int ok = event_log_flush(log);
+
+	if (fclose(log->file) != 0 && ok)
+	{
+		fprintf(stderr, "Unable to write file \"%s\".\n", log->file_name);
+		ok = 0;
+	}
+	free(log->buffer);
+	return ok ? 0 : 2;
+}
+
+
+/*
+ * Event-driven simulation (-e).
+ *
+ * Rather than stepping one time unit at a time, keep a heap holding one
+ * event per busy core (the earlier of its job finishing or its quantum
+ * running out) and one for the next arrival, and jump straight to the
+ * earliest.  At each event time the first three steps of the tick loop run
+ * over the same jobs in the same order, so the scheduler sees exactly the
+ * same calls: simultaneous finishes and arrivals in arrival order, and
+ * quantum expiries by core.
+ *
+ * Running jobs are not decremented every time unit.  Each core remembers
+ * when its job's run_time and quantum clock were last brought up to date
+ * and catches them up whenever the core is looked at.  The timing diagram
+ * is likewise filled in per core, one segment each time the core changes
+ * hands.
+ */
+typedef struct _simulator_event_t
+{
+	int time;
+	int core_id;  // -1 for the next arrival
+	int handle;   // -1 while the event is not in the heap
+} simulator_event_t;
+
+typedef struct _simulator_t
+{
+	/*
+	 * Where the jobs come from.  A loaded job list has every job in
+	 * jobs[], found through position[], with ties taken in the old list
+	 * order.  A streamed one (jobs == NULL) is read from reader as the
+	 * jobs come due, and only the jobs from the oldest one not yet
+	 * finished up to the newest one read are kept, in the window ring at
+	 * job_id modulo window_capacity.  Ties are then taken by job_id.
+	 */
+	simulator_job_list_t *jobs;
+	int *position;
+	simulator_scan_order_t *order;
+	int job_count;  // when streaming, the number of jobs read so far
+
+	simulator_reader_t *reader;
+	simulator_job_list_t *window;
+	int window_capacity, window_first;
+	int last_arrival, read_failed;
+
+	int next_arrival;  // jobs[] index, or job_id when streaming, of the next job to arrive
+	int jobs_alive;
+
+	int cores, scheme, quantum;
+	int *quantum_clock;
+	int *core_job;     // job_id running on each core, -1 if idle
+	int *core_synced;  // time the core's job and quantum clock were last updated
+	int cores_working;
+
+	priqueue_t events;
+	simulator_event_t *core_events;
+	simulator_event_t arrival_event;
+
+	simulator_diagram_t *core_timing_diagram;
+	const simulator_checkpoint_t *checkpoint;  // NULL when streaming
+	simulator_event_log_t *log;  // NULL for none
+} simulator_t;
+
+// The job with the given job_id, or NULL if there is none left by that id.
+simulator_job_list_t *find_job(simulator_t *sim, int job_id)
+{
+	if (job_id < 0 || job_id >= sim->job_count)
+		return NULL;
+
+	if (sim->jobs != NULL)
+		return &sim->jobs[sim->position[job_id]];
+
+	if (job_id < sim->window_first)
+		return NULL;
+	return &sim->window[job_id % sim->window_capacity];
+}
+
+// Read the next streamed job into the window.  Returns 0 at the end of
+// the input, or with read_failed set if the input was bad.
+int read_job(simulator_t *sim)
+{
+	simulator_job_list_t job;
+	int i, result;
+
+	if (sim->read_failed || (result = reader_next(sim->reader, &job)) == 0)
+		return 0;
+
+	if (result < 0)
+	{
+		sim->read_failed = 1;
+		return 0;
+	}
+
+	if (job.arrival_time < sim->last_arrival)
+	{
+		fprintf(stderr, "A streamed input must be sorted by arrival time (job %d).\n", job.job_id);
+		sim->read_failed = 1;
+		return 0;
+	}
+	sim->last_arrival = job.arrival_time;
+
+	if (sim->job_count - sim->window_first == sim->window_capacity)
+	{
+		int capacity = sim->window_capacity * 2;
+		simulator_job_list_t *window = malloc(capacity * sizeof(simulator_job_list_t));
+
+		if (window == NULL)
+		{
+			fprintf(stderr, "Out of memory.\n");
+			sim->read_failed = 1;
+			return 0;
+		}
+
+		for (i = sim->window_first; i < sim->job_count; i++)
+			window[i % capacity] = sim->window[i % sim->window_capacity];
+
+		free(sim->window);
+		sim->window = window;
+		sim->window_capacity = capacity;
+	}
+
+	sim->window[job.job_id % sim->window_capacity] = job;
+	sim->job_count++;
+	return 1;
+}
+
+// The next job to arrive, or NULL once they all have.
+simulator_job_list_t *peek_arrival(simulator_t *sim)
+{
+	if (sim->jobs != NULL)
+		return (sim->next_arrival < sim->job_count) ? &sim->jobs[sim->next_arrival] : NULL;
+
+	if (sim->next_arrival == sim->job_count && !read_job(sim))
+		return NULL;
+	return &sim->window[sim->next_arrival % sim->window_capacity];
+}
+
+// Drop finished jobs off the front of the window.
+void retire_jobs(simulator_t *sim)
+{
+	while (sim->jobs == NULL && sim->window_first < sim->job_count &&
+			sim->window[sim->window_first % sim->window_capacity].finished)
+		sim->window_first++;
+}
+
+// Insert job_id into ids[0..count), which is kept in the order ties are taken.
+void order_insert(simulator_t *sim, int *ids, int count, int job_id)
+{
+	if (sim->order != NULL)
+	{
+		scan_order_insert(sim->order, ids, count, job_id);
+		return;
+	}
+
+	while (count > 0 && ids[count - 1] > job_id)
+	{
+		ids[count] = ids[count - 1];
+		count--;
+	}
+	ids[count] = job_id;
+}
+
+// Take the next of ids[0..*count) to finish.
+int order_next_finished(simulator_t *sim, int *ids, int *count)
+{
+	if (sim->order != NULL)
+		return scan_order_next_finished(sim->order, ids, count);
+
+	int job_id = ids[0];
+	memmove(ids, ids + 1, --(*count) * sizeof(int));
+	return job_id;
+}
+
+void print_active_jobs(simulator_t *sim)
+{
+	if (sim->jobs != NULL)
+	{
+		print_available_jobs(sim->jobs, sim->job_count);
+		return;
+	}
+
+	printf("Active jobs are: ");
+
+	int i, first = 1;
+	for (i = sim->window_first; i < sim->job_count; i++)
+	{
+		simulator_job_list_t *job = find_job(sim, i);
+
+		if (job->arrived && !job->finished)
+		{
+			printf(first ? "%d" : ", %d", job->job_id);
+			first = 0;
+		}
+	}
+
+	if (!first)
+		printf("\n");
+}
+
+int compare_events(const void *a, const void *b)
+{
+	return ((const simulator_event_t *)a)->time - ((const simulator_event_t *)b)->time;
+}
+
+void schedule_event(simulator_t *sim, simulator_event_t *event, int time)
+{
+	event->time = time;
+
+	if (event->handle == -1)
+		event->handle = priqueue_offer(&sim->events, event);
+	else
+		priqueue_update(&sim->events, event->handle);
+}
+
+void cancel_event(simulator_t *sim, simulator_event_t *event)
+{
+	if (event->handle != -1)
+	{
+		priqueue_remove_handle(&sim->events, event->handle);
+		event->handle = -1;
+	}
+}
+
+// Bring the job on core_id up to date, as if it ran every unit until time.
+void sync_core(simulator_t *sim, int core_id, int time)
+{
+	if (sim->core_job[core_id] != -1)
+	{
+		int elapsed = time - sim->core_synced[core_id];
+		find_job(sim, sim->core_job[core_id])->run_time -= elapsed;
+		sim->quantum_clock[core_id] -= elapsed;
+	}
+	sim->core_synced[core_id] = time;
+}
+
+// Fill in core_id's timing diagram with its current job up to time.
+int draw_core(simulator_t *sim, int core_id, int time)
+{
+	if (sim->core_timing_diagram == NULL)
+		return 1;
+
+	simulator_diagram_t *diagram = &sim->core_timing_diagram[core_id];
+
+	if (!diagram_append(diagram, sim->core_job[core_id], time - diagram->end))
+	{
+		fprintf(stderr, "Out of memory.\n");
+		return 0;
+	}
+	return 1;
+}
+
+// Hand core_id to job_id (-1 for idle) from time onwards.
+int set_core(simulator_t *sim, int core_id, int job_id, int time)
+{
+	if (!draw_core(sim, core_id, time))
+		return 0;
+
+	if (sim->core_job[core_id] != -1)
+		sim->cores_working--;
+	if (job_id != -1)
+		sim->cores_working++;
+
+	sim->core_job[core_id] = job_id;
+	sim->core_synced[core_id] = time;
+	return 1;
+}
+
+// Queue the next thing that will happen on core_id by itself.
+void schedule_core(simulator_t *sim, int core_id)
+{
+	simulator_event_t *event = &sim->core_events[core_id];
+
+	if (sim->core_job[core_id] == -1)
+	{
+		cancel_event(sim, event);
+		return;
+	}
+
+	int until = find_job(sim, sim->core_job[core_id])->run_time;
+	if (scheme_has_quantum(sim->scheme) && sim->quantum_clock[core_id] < until)
+		until = sim->quantum_clock[core_id];
+
+	schedule_event(sim, event, sim->core_synced[core_id] + until);
+}
+
+// Add a record to the event log, if there is one.
+void log_event(simulator_t *sim, int time, int event, int job_id, int core_id)
+{
+	if (sim->log != NULL)
+		event_log_write(sim->log, time, event, job_id, core_id, sim->jobs_alive - sim->cores_working);
+}
+
+// Give core_id to new_job_id if it is a job that can run; -1 leaves it idle.
+// A job that had to migrate runs for as much longer as s charged it.
+int activate_job(simulator_t *sim, scheduler_t *s, int new_job_id, int core_id, int time)
+{
+	if (new_job_id != -1)
+	{
+		simulator_job_list_t *job = find_job(sim, new_job_id);
+
+		if (job == NULL || !job->arrived || job->finished)
+			return 0;
+		job->core_id = core_id;
+		job->run_time += scheduler_core_penalty_r(s, core_id);
+	}
+
+	return set_core(sim, core_id, new_job_id, time);
+}
+
+/*
+ * A checkpoint of a loaded run is a checkpoint_header_t, the job list, the
+ * scan order, each core's quantum clock and job, each core's timing
+ * diagram if there are any, and then the scheduler's own checkpoint.  It
+ * is made once everything due at its time has been done, with every core
+ * brought up to date, so the event heap can be rebuilt from the cores.
+ */
+#define CHECKPOINT_MAGIC "SIMCHKPT"
+#define CHECKPOINT_VERSION 1
+
+typedef struct _checkpoint_header_t
+{
+	char magic[8];
+	uint32_t version;
+	int32_t cores, scheme, quantum, job_count;
+	int32_t time, next_arrival, jobs_alive;
+	int32_t diagrams;  // whether the timing diagrams follow
+} checkpoint_header_t;
+
+// Write the run as it stands at time to the checkpoint file.  A new
+// checkpoint only replaces the old one once it has all been written.
+int write_checkpoint(simulator_t *sim, scheduler_t *s, int time)
+{
+	const char *file_name = sim->checkpoint->file_name;
+	simulator_scan_order_t *order = sim->order;
+	checkpoint_header_t header;
+	int i, ok, count = sim->job_count;
+
+	for (i = 0; i < sim->cores; i++)
+	{
+		sync_core(sim, i, time);
+		if (!draw_core(sim, i, time))
+			return 0;
+	}
+
+	char *temp_name = malloc(strlen(file_name) + 5);
+	sprintf(temp_name, "%s.tmp", file_name);
+
+	FILE *out = fopen(temp_name, "wb");
+	if (out == NULL)
+	{
+		fprintf(stderr, "Unable to open file \"%s\".\n", temp_name);
+		free(temp_name);
+		return 0;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+	header.version = CHECKPOINT_VERSION;
+	header.cores = sim->cores;
+	header.scheme = sim->scheme;
+	header.quantum = sim->quantum;
+	header.job_count = count;
+	header.time = time;
+	header.next_arrival = sim->next_arrival;
+	header.jobs_alive = sim->jobs_alive;
+	header.diagrams = (sim->core_timing_diagram != NULL);
+
+	ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+	     fwrite(sim->jobs, sizeof(simulator_job_list_t), count, out) == count &&
+	     fwrite(order->slot, sizeof(int), count, out) == count &&
+	     fwrite(order->job, sizeof(int), count, out) == count &&
+	     fwrite(&order->count, sizeof(int), 1, out) == 1 &&
+	     fwrite(sim->quantum_clock, sizeof(int), sim->cores, out) == sim->cores &&
+	     fwrite(sim->core_job, sizeof(int), sim->cores, out) == sim->cores;
+
+	for (i = 0; ok && header.diagrams && i < sim->cores; i++)
+	{
+		simulator_diagram_t *diagram = &sim->core_timing_diagram[i];
+
+		ok = fwrite(&diagram->count, sizeof(int), 1, out) == 1 &&
+		     fwrite(&diagram->end, sizeof(int), 1, out) == 1 &&
+		     fwrite(diagram->segments, sizeof(simulator_segment_t), diagram->count, out) == diagram->count;
+	}
+
+	ok = ok && scheduler_checkpoint_r(s, out) == 0;
+	ok = (fclose(out) == 0) && ok;
+	ok = ok && rename(temp_name, file_name) == 0;
+
+	if (!ok)
+	{
+		fprintf(stderr, "Unable to write checkpoint \"%s\".\n", file_name);
+		remove(temp_name);
+	}
+
+	free(temp_name);
+	return ok;
+}
+
+int read_checkpoint_file(simulator_t *sim, scheduler_t *s, FILE *in, int *time)
+{
+	simulator_scan_order_t *order = sim->order;
+	checkpoint_header_t header;
+	int i, count = sim->job_count;
+
+	if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, CHECKPOINT_MAGIC, 8) != 0 ||
+			header.version != CHECKPOINT_VERSION || header.cores != sim->cores || header.scheme != sim->scheme ||
+			header.quantum != sim->quantum || header.job_count != count || header.diagrams != (sim->core_timing_diagram != NULL) ||
+			header.next_arrival < 0 || header.next_arrival > count || header.jobs_alive < 0 || header.jobs_alive > count)
+		return 0;
+
+	for (i = 0; i < count; i++)
+	{
+		simulator_job_list_t job;
+
+		if (fread(&job, sizeof(job), 1, in) != 1 || job.job_id != sim->jobs[i].job_id || job.arrival_time != sim->jobs[i].arrival_time ||
+				job.priority != sim->jobs[i].priority || job.deadline != sim->jobs[i].deadline)
+			return 0;
+		sim->jobs[i] = job;
+	}
+
+	if (fread(order->slot, sizeof(int), count, in) != count || fread(order->job, sizeof(int), count, in) != count ||
+			fread(&order->count, sizeof(int), 1, in) != 1 || order->count < 0 || order->count > count ||
+			fread(sim->quantum_clock, sizeof(int), sim->cores, in) != sim->cores ||
+			fread(sim->core_job, sizeof(int), sim->cores, in) != sim->cores)
+		return 0;
+
+	for (i = 0; i < sim->cores; i++)
+	{
+		if (sim->core_job[i] < -1 || sim->core_job[i] >= count)
+			return 0;
+		if (sim->core_job[i] != -1)
+			sim->cores_working++;
+		sim->core_synced[i] = header.time;
+	}
+
+	for (i = 0; header.diagrams && i < sim->cores; i++)
+	{
+		simulator_diagram_t *diagram = &sim->core_timing_diagram[i];
+		int segment_count;
+
+		if (fread(&segment_count, sizeof(int), 1, in) != 1 || segment_count < 0 ||
+				fread(&diagram->end, sizeof(int), 1, in) != 1)
+			return 0;
+
+		simulator_segment_t *segments = realloc(diagram->segments, (segment_count ? segment_count : 1) * sizeof(simulator_segment_t));
+		if (segments == NULL)
+			return 0;
+
+		diagram->segments = segments;
+		diagram->capacity = segment_count ? segment_count : 1;
+		diagram->count = segment_count;
+		if (fread(diagram->segments, sizeof(simulator_segment_t), segment_count, in) != segment_count)
+			return 0;
+	}
+
+	if (scheduler_restore_r(s, in) != 0)
+		return 0;
+
+	sim->next_arrival = header.next_arrival;
+	sim->jobs_alive = header.jobs_alive;
+	*time = header.time;
+	return 1;
+}
+
+// Pick the run up from the checkpoint in sim->checkpoint->restore,
+// leaving the time it was made in *time.
+int read_checkpoint(simulator_t *sim, scheduler_t *s, int *time)
+{
+	const char *file_name = sim->checkpoint->restore;
+	FILE *in = fopen(file_name, "rb");
+
+	if (in == NULL)
+	{
+		fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
+		return 0;
+	}
+
+	int ok = read_checkpoint_file(sim, s, in, time);
+	fclose(in);
+
+	if (!ok)
+		fprintf(stderr, "The checkpoint \"%s\" is unreadable, or was not made from this job file with these options.\n", file_name);
+	return ok;
+}
+
+/*
+ * The event loop behind simulate_events() and simulate_stream(), once the
+ * job source in sim has been set up.
+ */
+int run_events(simulator_t *sim, scheduler_t *s, int cores, int scheme, int quantum, int *quantum_clock,
+               simulator_diagram_t *core_timing_diagram, int verbose, int *end_time)
+{
+	int i, status = 0;
+
+	sim->next_arrival = 0;
+	sim->jobs_alive = 0;
+	sim->cores = cores;
+	sim->scheme = scheme;
+	sim->quantum = quantum;
+	sim->quantum_clock = quantum_clock;
+	sim->cores_working = 0;
+	sim->core_timing_diagram = core_timing_diagram;
+
+	sim->core_job = malloc(cores * sizeof(int));
+	sim->core_synced = malloc(cores * sizeof(int));
+	sim->core_events = malloc(cores * sizeof(simulator_event_t));
+
+	int *finishing = malloc(cores * sizeof(int));
+	int *expiring = calloc(cores, sizeof(int));
+	int *touched = malloc(cores * sizeof(int));
+	int *is_touched = calloc(cores, sizeof(int));
+	int arriving_capacity = 16;
+	int *arriving = malloc(arriving_capacity * sizeof(int));
+	scheduler_job_desc_t *arriving_jobs = malloc(arriving_capacity * sizeof(scheduler_job_desc_t));
+	int *arriving_cores = malloc(arriving_capacity * sizeof(int));
+
+	for (i = 0; i < cores; i++)
+	{
+		sim->core_job[i] = -1;
+		sim->core_synced[i] = 0;
+		sim->core_events[i].core_id = i;
+		sim->core_events[i].handle = -1;
+	}
+
+	priqueue_init(&sim->events, compare_events);
+	sim->arrival_event.core_id = -1;
+	sim->arrival_event.handle = -1;
+
+	int time = 0, finishing_count, touched_count;
+	int checkpoint_every = (sim->checkpoint != NULL && sim->checkpoint->file_name != NULL) ? sim->checkpoint->every : 0;
+	long long next_checkpoint = checkpoint_every;
+	simulator_job_list_t *first;
+
+	if (sim->checkpoint != NULL && sim->checkpoint->restore != NULL)
+	{
+		if (!read_checkpoint(sim, s, &time))
+		{
+			status = 2;
+			goto done;
+		}
+		if (checkpoint_every > 0)
+			next_checkpoint = ((long long)time / checkpoint_every + 1) * checkpoint_every;
+
+		if ((first = peek_arrival(sim)) != NULL)
+			schedule_event(sim, &sim->arrival_event, first->arrival_time);
+		for (i = 0; i < cores; i++)
+			schedule_core(sim, i);
+
+		// Everything due at the checkpoint's own time was done before it was made.
+		simulator_event_t *event = priqueue_peek(&sim->events);
+		if (event != NULL)
+			time = event->time;
+	}
+	else if ((first = peek_arrival(sim)) != NULL)
+	{
+		schedule_event(sim, &sim->arrival_event, first->arrival_time);
+		time = first->arrival_time;
+	}
+
+	while (sim->jobs_alive > 0 || peek_arrival(sim) != NULL)
+	{
+		if (verbose)
+			printf("=== [TIME %d] ===\n", time);
+
+		/*
+		 * Collect everything due now.  A core's event is either its job
+		 * finishing or, failing that, its quantum expiring.
+		 */
+		simulator_event_t *event;
+		int arrivals_due = 0;
+		finishing_count = 0;
+		touched_count = 0;
+
+		while ((event = priqueue_peek(&sim->events)) != NULL && event->time == time)
+		{
+			priqueue_poll(&sim->events);
+			event->handle = -1;
+
+			if (event->core_id == -1)
+			{
+				arrivals_due = 1;
+				continue;
+			}
+
+			int core_id = event->core_id;
+			sync_core(sim, core_id, time);
+			touched[touched_count++] = core_id;
+			is_touched[core_id] = 1;
+
+			if (find_job(sim, sim->core_job[core_id])->run_time == 0)
+				order_insert(sim, finishing, finishing_count++, sim->core_job[core_id]);
+			else if (scheme_has_quantum(scheme) && quantum_clock[core_id] == 0)
+				expiring[core_id] = 1;
+		}
+
+		/*
+		 * 1. Jobs that finished in the last time unit.
+		 */
+		while (finishing_count > 0)
+		{
+			simulator_job_list_t *job = find_job(sim, order_next_finished(sim, finishing, &finishing_count));
+			int job_id = job->job_id;
+			int core_id = job->core_id;
+			int new_job_id = scheduler_job_finished_r(s, core_id, job_id, time);
+
+			if (scheme_has_quantum(scheme))
+				quantum_clock[core_id] = core_quantum(s, scheme, quantum, core_id);
+
+			job->finished = 1;
+			job->core_id = -1;
+			sim->jobs_alive--;
+			retire_jobs(sim);
+
+			if (!activate_job(sim, s, new_job_id, core_id, time))
+			{
+				printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
+				print_active_jobs(sim);
+				status = 3;
+				goto done;
+			}
+
+			log_event(sim, time, EVENT_FINISH, job_id, core_id);
+			if (new_job_id != -1)
+				log_event(sim, time, EVENT_RUN, new_job_id, core_id);
+
+			if (verbose)
+			{
+				printf("Job %d, running on core %d, finished. Core %d is now running job %d.\n", job_id, core_id, core_id, new_job_id);
+				printf("  Queue: "); scheduler_show_queue_r(s); printf("\n\n");
+			}
+		}
+
+		if (sim->jobs_alive == 0 && peek_arrival(sim) == NULL)
+			break;
+
+		/*
+		 * 2. Quantums that expired in the last time unit, by core.
+		 */
+		for (i = 0; i < cores; i++)
+		{
+			if (!expiring[i])
+				continue;
+
+			expiring[i] = 0;
+
+			simulator_job_list_t *old_job = find_job(sim, sim->core_job[i]);
+			int old_job_id = old_job->job_id;
+			int new_job_id = scheduler_quantum_expired_r(s, i, time);
+
+			old_job->core_id = -1;
+			quantum_clock[i] = core_quantum(s, scheme, quantum, i);
+
+			if (!activate_job(sim, s, new_job_id, i, time))
+			{
+				printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
+				print_active_jobs(sim);
+				status = 3;
+				goto done;
+			}
+
+			log_event(sim, time, EVENT_EXPIRE, old_job_id, i);
+			if (new_job_id != -1)
+				log_event(sim, time, EVENT_RUN, new_job_id, i);
+
+			if (verbose)
+			{
+				printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", old_job_id, i, i, new_job_id);
+				printf("  Queue: "); scheduler_show_queue_r(s); printf("\n\n");
+			}
+		}
+
+		/*
+		 * 3. New jobs arriving now.
+		 */
+		if (arrivals_due)
+		{
+			simulator_job_list_t *job;
+			int a, arriving_count = 0;
+			for (; (job = peek_arrival(sim)) != NULL && job->arrival_time == time; sim->next_arrival++)
+			{
+				if (arriving_count == arriving_capacity)
+				{
+					arriving_capacity *= 2;
+					arriving = realloc(arriving, arriving_capacity * sizeof(int));
+					arriving_jobs = realloc(arriving_jobs, arriving_capacity * sizeof(scheduler_job_desc_t));
+					arriving_cores = realloc(arriving_cores, arriving_capacity * sizeof(int));
+				}
+				order_insert(sim, arriving, arriving_count++, job->job_id);
+			}
+
+			// Hand the scheduler every arrival at once, then act on its answers in order.
+			for (a = 0; a < arriving_count; a++)
+			{
+				job = find_job(sim, arriving[a]);
+				arriving_jobs[a].job_number = job->job_id;
+				arriving_jobs[a].running_time = job->run_time;
+				arriving_jobs[a].priority = job->priority;
+				arriving_jobs[a].deadline = job->deadline;
+			}
+			scheduler_new_jobs_r(s, arriving_jobs, arriving_count, time, arriving_cores);
+
+			for (a = 0; a < arriving_count; a++)
+			{
+				job = find_job(sim, arriving[a]);
+				int new_job_core_id = arriving_cores[a];
+				job->arrived = 1;
+				sim->jobs_alive++;
+
+				if (new_job_core_id >= 0 && new_job_core_id < cores)
+				{
+					if (verbose)
+					{
+						printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
+								job->job_id, job->run_time, job->priority, job->job_id, new_job_core_id);
+						printf("  Queue: "); scheduler_show_queue_r(s); printf("\n\n");
+					}
+
+					// Take the core from whoever is using it.
+					int preempted_job_id = sim->core_job[new_job_core_id];
+					if (preempted_job_id != -1)
+					{
+						sync_core(sim, new_job_core_id, time);
+						find_job(sim, preempted_job_id)->core_id = -1;
+					}
+
+					job->core_id = new_job_core_id;
+					if (!set_core(sim, new_job_core_id, job->job_id, time))
+					{
+						status = 3;
+						goto done;
+					}
+
+					log_event(sim, time, EVENT_ARRIVE, job->job_id, new_job_core_id);
+					if (preempted_job_id != -1)
+						log_event(sim, time, EVENT_PREEMPT, preempted_job_id, new_job_core_id);
+					log_event(sim, time, EVENT_RUN, job->job_id, new_job_core_id);
+
+					if (scheme_has_quantum(scheme))
+						quantum_clock[new_job_core_id] = core_quantum(s, scheme, quantum, new_job_core_id);
+
+					if (!is_touched[new_job_core_id])
+					{
+						touched[touched_count++] = new_job_core_id;
+						is_touched[new_job_core_id] = 1;
+					}
+				}
+				else if (new_job_core_id == -1)
+				{
+					if (verbose)
+					{
+						printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
+								job->job_id, job->run_time, job->priority, job->job_id);
+						printf("  Queue: "); scheduler_show_queue_r(s); printf("\n\n");
+					}
+					log_event(sim, time, EVENT_ARRIVE, job->job_id, -1);
+				}
+				else
+				{
+					printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", new_job_core_id);
+					print_available_cores(cores);
+					status = 3;
+					goto done;
+				}
+			}
+
+			if ((job = peek_arrival(sim)) != NULL)
+				schedule_event(sim, &sim->arrival_event, job->arrival_time);
+			else if (sim->read_failed)
+			{
+				status = 2;
+				goto done;
+			}
+		}
+
+		/*
+		 * Queue up what happens next on every core that changed.
+		 */
+		for (i = 0; i < touched_count; i++)
+		{
+			schedule_core(sim, touched[i]);
+			is_touched[touched[i]] = 0;
+		}
+
+		/*
+		 * Sanity Checking, as in step 6 of the tick loop.
+		 */
+		if (sim->jobs_alive > 0 && sim->cores_working == 0)
+		{
+			printf("All cores are idle and at least one job remains unscheduled.\n");
+			print_active_jobs(sim);
+			status = 3;
+			goto done;
+		}
+
+		/*
+		 * Write a checkpoint, if one is due.
+		 */
+		if (checkpoint_every > 0 && time >= next_checkpoint)
+		{
+			if (!write_checkpoint(sim, s, time))
+			{
+				status = 2;
+				goto done;
+			}
+			next_checkpoint = ((long long)time / checkpoint_every + 1) * checkpoint_every;
+		}
+
+		/*
+		 * Jump to the next event.
+		 */
+		event = priqueue_peek(&sim->events);
+		assert(event != NULL && event->time > time);
+		time = event->time;
+	}
+
+	if (sim->read_failed)
+	{
+		status = 2;
+		goto done;
+	}
+
+	for (i = 0; i < cores; i++)
+	{
+		if (!draw_core(sim, i, time))
+		{
+			status = 3;
+			break;
+		}
+	}
+
+	*end_time = time;
+
+done:
+	priqueue_destroy(&sim->events);
+	free(arriving_cores);
+	free(arriving_jobs);
+	free(arriving);
+	free(is_touched);
+	free(touched);
+	free(expiring);
+	free(finishing);
+	free(sim->core_events);
+	free(sim->core_synced);
+	free(sim->core_job);
+
+	return status;
+}
+
+/*
+ * Run jobs[] through s from start to finish, leaving the time the last job
+ * finished in *end_time.  The narration of every scheduler call is printed
+ * only when verbose is set, and core_timing_diagram may be NULL to skip
+ * drawing the diagram.  checkpoint may be NULL, for a run that neither
+ * writes nor restores checkpoints, and log NULL for no event log.  Returns 0, 2 if a checkpoint could not
+ * be written or restored, or 3 if the scheduler made an invalid choice.
+ */
+int simulate_events(scheduler_t *s, simulator_job_list_t *jobs, int *position, simulator_scan_order_t *order, int job_count,
+                    int cores, int scheme, int quantum, int *quantum_clock, simulator_diagram_t *core_timing_diagram, int verbose, int *end_time,
+                    const simulator_checkpoint_t *checkpoint, simulator_event_log_t *log)
+{
+	simulator_t sim;
+
+	sim.checkpoint = checkpoint;
+	sim.log = log;
+	sim.jobs = jobs;
+	sim.position = position;
+	sim.order = order;
+	sim.job_count = job_count;
+	sim.reader = NULL;
+	sim.window = NULL;
+	sim.read_failed = 0;
+
+	return run_events(&sim, s, cores, scheme, quantum, quantum_clock, core_timing_diagram, verbose, end_time);
+}
+
+/*
+ * Like simulate_events(), but with the jobs read from reader only as they
+ * come due, so that the whole file never has to be in memory.  The file
+ * must be sorted by arrival time, and simultaneous events are taken in
+ * file order rather than in the old list order.  The number of jobs read
+ * is left in *job_count.  Returns 2 if the input turns out to be bad.
+ */
+int simulate_stream(scheduler_t *s, simulator_reader_t *reader, int cores, int scheme, int quantum, int *quantum_clock,
+                    simulator_diagram_t *core_timing_diagram, int verbose, int *end_time, int *job_count,
+                    simulator_event_log_t *log)
+{
+	simulator_t sim;
+
+	sim.checkpoint = NULL;
+	sim.log = log;
+	sim.jobs = NULL;
+	sim.position = NULL;
+	sim.order = NULL;
+	sim.job_count = 0;
+	sim.reader = reader;
+	sim.window_capacity = 64;
+	sim.window = malloc(sim.window_capacity * sizeof(simulator_job_list_t));
+	sim.window_first = 0;
+	sim.last_arrival = 0;
+	sim.read_failed = 0;
+
+	int status = run_events(&sim, s, cores, scheme, quantum, quantum_clock, core_timing_diagram, verbose, end_time);
+
+	*job_count = sim.job_count;
+	free(sim.window);
+	return status;
+}
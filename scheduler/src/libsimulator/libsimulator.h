@@ -0,0 +1,204 @@
+/** @file libsimulator.h
+ */
+
+#ifndef LIBSIMULATOR_H_
+#define LIBSIMULATOR_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "libscheduler/libscheduler.h"
+
+/*
+ * The job list is sorted by arrival time once it is loaded and never
+ * reordered after that, so jobs get admitted by walking a single cursor
+ * forward and a finished job just stays where it is, flagged as finished.
+ * job_id is the job's line in the input file, so position[] maps it back
+ * to its place in the list.  deadline is -1 for a job without one.
+ */
+typedef struct _simulator_job_list_t
+{
+	int job_id, arrival_time, run_time, priority, deadline;
+	int core_id, arrived, finished;
+} simulator_job_list_t;
+
+/*
+ * The simulator used to keep its job list in file order, delete a finished
+ * job by moving the last job into its place, and handle simultaneous
+ * finishes (and arrivals) in list order.  Which core picks up which queued
+ * job depends on that order, and the example outputs were made with it, so
+ * it is still tracked here: slot[] is where each job_id would sit in that
+ * list and job[] is the inverse.
+ */
+typedef struct _simulator_scan_order_t
+{
+	int *slot;
+	int *job;
+	int count;
+} simulator_scan_order_t;
+
+/*
+ * A core's timing diagram, kept as one segment per stretch of time the core
+ * spent on the same job (job_id -1 while idle) and only turned into text
+ * when it is printed.  Appending is amortized O(1), and the memory used
+ * grows with the number of context switches rather than with time.
+ */
+typedef struct _simulator_segment_t
+{
+	int job_id, start, length;
+} simulator_segment_t;
+
+typedef struct _simulator_diagram_t
+{
+	simulator_segment_t *segments;
+	int count, capacity;
+	int end;  // the time the diagram is filled in up to
+} simulator_diagram_t;
+
+/*
+ * Checkpointing for simulate_events().  Every `every` time units (at the
+ * first event on or after each multiple of it) the whole state of the run,
+ * the scheduler's included, is written to file_name, replacing the last
+ * checkpoint written there.  With restore set, the run picks up from the
+ * checkpoint in that file instead of starting at the first arrival; it must
+ * have been made from the same job file, cores and scheme.
+ */
+typedef struct _simulator_checkpoint_t
+{
+	int every;  // 0 for no checkpoints
+	const char *file_name;
+	const char *restore;  // NULL to start from the beginning
+} simulator_checkpoint_t;
+
+/*
+ * The binary trace format, as written by csv2trace: a trace_header_t and
+ * then job_count packed trace_record_t in job_id order, in host byte
+ * order.  With TRACE_DELTA_ARRIVALS set, each arrival_time is the change
+ * from the previous job's.  With TRACE_DEADLINES set, the records are
+ * followed by job_count int32_t deadlines, in the same order.
+ */
+#define TRACE_MAGIC "SCHTRACE"
+#define TRACE_VERSION 1
+#define TRACE_DELTA_ARRIVALS 0x1
+#define TRACE_DEADLINES 0x2
+
+typedef struct _trace_header_t
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t job_count;
+} trace_header_t;
+
+typedef struct _trace_record_t
+{
+	int32_t arrival_time;
+	int32_t run_time;
+	int32_t priority;
+} trace_record_t;
+
+/*
+ * A structured log of a run, for analysis without parsing the narration.
+ * Every record is (time, event, job_id, core_id, queue_length), where
+ * queue_length is the number of jobs waiting for a core once the event has
+ * been handled.  An arrival's core_id is the core it was given, or -1.
+ * EVENT_RUN is a job being put on a core, and EVENT_PREEMPT one losing its
+ * core to an arrival.  Records are gathered in a large buffer that is only
+ * written out when it fills up, and on event_log_close().  The formats are:
+ *
+ *   binary  an event_log_header_t, then packed event_log_record_t in host
+ *           byte order
+ *   csv     a header line, then one line per record, with events by name
+ *   ndjson  one JSON object per record and line
+ */
+typedef enum { EVENT_ARRIVE = 0, EVENT_RUN, EVENT_PREEMPT, EVENT_EXPIRE, EVENT_FINISH } event_type_t;
+typedef enum { EVENT_LOG_BINARY = 0, EVENT_LOG_CSV, EVENT_LOG_NDJSON } event_log_format_t;
+
+#define EVENT_LOG_MAGIC "SCHEVLOG"
+#define EVENT_LOG_VERSION 1
+
+typedef struct _event_log_header_t
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+} event_log_header_t;
+
+typedef struct _event_log_record_t
+{
+	int32_t time, event, job_id, core_id, queue_length;
+} event_log_record_t;
+
+typedef struct _simulator_event_log_t
+{
+	FILE *file;
+	const char *file_name;
+	int format;
+	char *buffer;
+	int size, used;
+	int failed;
+} simulator_event_log_t;
+
+/*
+ * Reads a job file one job at a time.  A CSV file goes through a large
+ * buffer, with the numbers parsed by hand instead of with strtok() and
+ * atoi().  A binary trace is mapped into memory and its records are read
+ * straight out of the mapping.
+ */
+typedef struct _simulator_reader_t
+{
+	FILE *file;
+	char *buffer;
+	int size, start, end;  // buffer[start, end) has not been parsed yet
+	int eof, jobs_read;
+
+	void *map;  // the mapped trace, or NULL for a CSV file
+	size_t map_size;
+	const trace_record_t *records;
+	const int32_t *deadlines;  // NULL if the trace has none
+	long record_count;
+	int delta_arrivals, last_arrival;
+} simulator_reader_t;
+
+extern const char *scheme_names[];
+extern const char *event_names[];
+
+int  reader_open           (simulator_reader_t *reader, const char *file_name);
+int  reader_next           (simulator_reader_t *reader, simulator_job_list_t *job);
+void reader_close          (simulator_reader_t *reader);
+
+int  simulator_load_jobs   (const char *file_name, simulator_job_list_t **jobs, int **position, int *job_count);
+int  compare_arrivals      (const void *a, const void *b);
+int  set_active_job        (int job_id, int core_id, simulator_job_list_t *jobs, int *position, int job_count);
+
+void scan_order_init         (simulator_scan_order_t *order, int job_count);
+void scan_order_destroy      (simulator_scan_order_t *order);
+void scan_order_remove       (simulator_scan_order_t *order, int job_id);
+void scan_order_insert       (simulator_scan_order_t *order, int *ids, int count, int job_id);
+int  scan_order_next_finished(simulator_scan_order_t *order, int *ids, int *count);
+
+void print_available_jobs  (simulator_job_list_t *jobs, int job_count);
+void print_available_cores (int cores);
+void job_time_string       (char *time_string, int job_id);
+int  scheme_has_quantum    (int scheme);
+int  core_quantum          (scheduler_t *s, int scheme, int quantum, int core_id);
+int  parse_number_list     (const char *list, int **values, int *count);
+int  parse_scheme_list     (char *list, int **schemes, int **quanta, int *count);
+
+void diagram_init            (simulator_diagram_t *diagram);
+int  diagram_append          (simulator_diagram_t *diagram, int job_id, int length);
+void diagram_print           (simulator_diagram_t *diagram);
+void diagram_destroy         (simulator_diagram_t *diagram);
+
+int  event_log_open          (simulator_event_log_t *log, const char *file_name, int format);
+void event_log_write         (simulator_event_log_t *log, int time, int event, int job_id, int core_id, int queue_length);
+int  event_log_close         (simulator_event_log_t *log);
+
+int  simulate_events       (scheduler_t *s, simulator_job_list_t *jobs, int *position, simulator_scan_order_t *order, int job_count,
+                            int cores, int scheme, int quantum, int *quantum_clock, simulator_diagram_t *core_timing_diagram, int verbose, int *end_time,
+                            const simulator_checkpoint_t *checkpoint, simulator_event_log_t *log);
+int  simulate_stream       (scheduler_t *s, simulator_reader_t *reader, int cores, int scheme, int quantum, int *quantum_clock,
+                            simulator_diagram_t *core_timing_diagram, int verbose, int *end_time, int *job_count,
+                            simulator_event_log_t *log);
+
+#endif /* LIBSIMULATOR_H_ */
@@ -0,0 +1,397 @@
+/** @file queuebench.c
+ *
+ * Times libpriqueue the way the schedulers use it, and the bucket lists
+ * libscheduler runs FCFS, RR, PRI and PPRI on instead.  For each queue
+ * backend, key pattern and size it reports the nanoseconds per operation and
+ * the allocations made by each of:
+ *
+ *   offer   offer n entries to an empty queue
+ *   at      read every entry in order with priqueue_at(), or by walking
+ *           the bucket lists
+ *   poll    poll all n entries back out
+ *   hold    with n entries queued, poll one and offer one, n times over;
+ *           the steady state of a busy scheduler
+ *   remove  take out every other entry by its handle; the bucket lists
+ *           have no handles, so they skip this
+ *
+ * The key patterns are the ones the schemes produce:
+ *
+ *   fifo    every key the same, so the queue is FIFO (FCFS, RR)
+ *   random  random keys (SJF, PSJF)
+ *   few     8 distinct keys (PRI, PPRI)
+ *
+ * The bucket lists only take small keys, so they skip the random pattern.
+ * They do not use libpriqueue at all, so they are left out of the -locked
+ * build.
+ *
+ * Allocations are counted by wrapping malloc(), calloc() and realloc() at
+ * link time, so this has to be linked with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+#include "libpriqueue/libpriqueue.h"
+
+
+#ifdef PRIQUEUE_CONCURRENT
+#define BENCH_BUILD "-locked"
+#else
+#define BENCH_BUILD ""
+#endif
+
+#define PASS_OPERATIONS 1000000  // small sizes are repeated up to this many operations
+#define FEW_KEYS 8
+#define BENCH_BUCKETS 64  // as many as libscheduler's QUEUE_BUCKETS
+
+
+/*
+ * Allocation counting.
+ */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+unsigned long long allocations;
+
+void *__wrap_malloc(size_t size)
+{
+	allocations++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+	allocations++;
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __real_realloc(ptr, size);
+}
+
+
+typedef struct _bench_item_t
+{
+	unsigned long long key;
+	struct _bench_item_t *next;  // the next entry in its bucket list
+} bench_item_t;
+
+int compare_items(const void *a, const void *b)
+{
+	const bench_item_t *left = a, *right = b;
+
+	if (left->key != right->key)
+		return (left->key < right->key) ? -1 : 1;
+	return 0;
+}
+
+typedef enum { PATTERN_FIFO = 0, PATTERN_RANDOM, PATTERN_FEW, PATTERN_COUNT } bench_pattern_t;
+const char *pattern_names[] = { "fifo", "random", "few" };
+
+typedef enum { OP_OFFER = 0, OP_AT, OP_POLL, OP_HOLD, OP_REMOVE, OP_COUNT } bench_op_t;
+const char *op_names[] = { "offer", "at", "poll", "hold", "remove" };
+
+typedef struct _bench_result_t
+{
+	double seconds;
+	unsigned long long operations, allocations;
+} bench_result_t;
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-m <max size>] [-n <min size>]\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -n  smallest queue size, a power of 10 (default: 100)\n");
+	fprintf(stderr, "  -m  largest queue size, a power of 10 (default: 10000000)\n");
+}
+
+double now_seconds()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1000000000.0;
+}
+
+void fill_keys(bench_item_t *items, int count, int pattern, unsigned int *seed)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		if (pattern == PATTERN_FIFO)
+			items[i].key = 0;
+		else if (pattern == PATTERN_RANDOM)
+			items[i].key = ((unsigned long long)rand_r(seed) << 31) | rand_r(seed);
+		else
+			items[i].key = rand_r(seed) % FEW_KEYS;
+	}
+}
+
+// Start timing one operation; the caller runs it and calls bench_stop().
+void bench_start(double *start, unsigned long long *start_allocations)
+{
+	*start_allocations = allocations;
+	*start = now_seconds();
+}
+
+void bench_stop(bench_result_t *result, double start, unsigned long long start_allocations, int operations)
+{
+	result->seconds += now_seconds() - start;
+	result->allocations += allocations - start_allocations;
+	result->operations += operations;
+}
+
+/*
+ * A queue backend: which key patterns it takes, and how to run one pass of
+ * every operation over n entries, adding to results[].  An operation the
+ * backend does not have is left with no operations counted.  The priqueue_t
+ * backends share priqueue_pass(), with their own init and offer.
+ */
+typedef struct _bench_backend_t
+{
+	const char *name;
+	unsigned int patterns;  // bit n set if it takes pattern n
+	void (*init)(priqueue_t *q);
+	int (*offer)(priqueue_t *q, bench_item_t *item);
+	void (*pass)(const struct _bench_backend_t *backend, bench_item_t *items, bench_item_t *spares, int *handles,
+	             int n, bench_result_t *results);
+} bench_backend_t;
+
+void heap_init(priqueue_t *q) { priqueue_init(q, compare_items); }
+int heap_offer(priqueue_t *q, bench_item_t *item) { return priqueue_offer(q, item); }
+
+void keyed_init(priqueue_t *q) { priqueue_init_keyed(q); }
+int keyed_offer(priqueue_t *q, bench_item_t *item) { return priqueue_offer_key(q, item, item->key); }
+
+void priqueue_pass(const bench_backend_t *backend, bench_item_t *items, bench_item_t *spares, int *handles, int n,
+                   bench_result_t *results)
+{
+	priqueue_t q;
+	unsigned long long start_allocations;
+	double start;
+	int i;
+
+	backend->init(&q);
+
+	bench_start(&start, &start_allocations);
+	for (i = 0; i < n; i++)
+		backend->offer(&q, &items[i]);
+	bench_stop(&results[OP_OFFER], start, start_allocations, n);
+
+	bench_start(&start, &start_allocations);
+	for (i = 0; i < n; i++)
+		priqueue_at(&q, i);
+	bench_stop(&results[OP_AT], start, start_allocations, n);
+
+	bench_start(&start, &start_allocations);
+	for (i = 0; i < n; i++)
+		priqueue_poll(&q);
+	bench_stop(&results[OP_POLL], start, start_allocations, n);
+
+	for (i = 0; i < n; i++)
+		backend->offer(&q, &items[i]);
+
+	bench_start(&start, &start_allocations);
+	for (i = 0; i < n; i++)
+	{
+		priqueue_poll(&q);
+		backend->offer(&q, &spares[i]);
+	}
+	bench_stop(&results[OP_HOLD], start, start_allocations, n);
+
+	priqueue_destroy(&q);
+
+	// Handles are only known for entries offered to a fresh queue.
+	backend->init(&q);
+	for (i = 0; i < n; i++)
+		handles[i] = backend->offer(&q, &items[i]);
+
+	bench_start(&start, &start_allocations);
+	for (i = 0; i < n; i += 2)
+		priqueue_remove_handle(&q, handles[i]);
+	bench_stop(&results[OP_REMOVE], start, start_allocations, (n + 1) / 2);
+
+	priqueue_destroy(&q);
+}
+
+/*
+ * The bucket lists, as libscheduler keeps them: a FIFO list per key, linked
+ * through the entries, and a bitmap of the lists with entries in them, so
+ * the next entry is at the head of the lowest set bit.
+ */
+typedef struct _bench_buckets_t
+{
+	bench_item_t *head[BENCH_BUCKETS];
+	bench_item_t *tail[BENCH_BUCKETS];
+	unsigned long long bits;
+} bench_buckets_t;
+
+void buckets_push(bench_buckets_t *b, bench_item_t *item)
+{
+	int bucket = item->key;
+
+	item->next = NULL;
+	if (b->tail[bucket])
+		b->tail[bucket]->next = item;
+	else
+		b->head[bucket] = item;
+	b->tail[bucket] = item;
+	b->bits |= 1ULL << bucket;
+}
+
+bench_item_t *buckets_pop(bench_buckets_t *b)
+{
+	if (b->bits == 0)
+		return NULL;
+
+	int bucket = __builtin_ctzll(b->bits);
+	bench_item_t *item = b->head[bucket];
+
+	b->head[bucket] = item->next;
+	if (!b->head[bucket])
+	{
+		b->tail[bucket] = NULL;
+		b->bits &= ~(1ULL << bucket);
+	}
+	return item;
+}
+
+void buckets_pass(const bench_backend_t *backend, bench_item_t *items, bench_item_t *spares, int *handles, int n,
+                  bench_result_t *results)
+{
+	bench_buckets_t b;
+	unsigned long long start_allocations, bits;
+	volatile unsigned long long sink = 0;  // keeps the walk from being optimized away
+	bench_item_t *item;
+	double start;
+	int i;
+
+	memset(&b, 0, sizeof(b));
+
+	bench_start(&start, &start_allocations);
+	for (i = 0; i < n; i++)
+		buckets_push(&b, &items[i]);
+	bench_stop(&results[OP_OFFER], start, start_allocations, n);
+
+	bench_start(&start, &start_allocations);
+	for (bits = b.bits; bits != 0; bits &= bits - 1)
+	{
+		for (item = b.head[__builtin_ctzll(bits)]; item != NULL; item = item->next)
+			sink += item->key;
+	}
+	bench_stop(&results[OP_AT], start, start_allocations, n);
+
+	bench_start(&start, &start_allocations);
+	for (i = 0; i < n; i++)
+		buckets_pop(&b);
+	bench_stop(&results[OP_POLL], start, start_allocations, n);
+
+	for (i = 0; i < n; i++)
+		buckets_push(&b, &items[i]);
+
+	bench_start(&start, &start_allocations);
+	for (i = 0; i < n; i++)
+	{
+		buckets_pop(&b);
+		buckets_push(&b, &spares[i]);
+	}
+	bench_stop(&results[OP_HOLD], start, start_allocations, n);
+}
+
+#define ALL_PATTERNS ((1U << PATTERN_COUNT) - 1)
+
+const bench_backend_t backends[] = {
+	{ "heap" BENCH_BUILD, ALL_PATTERNS, heap_init, heap_offer, priqueue_pass },
+	{ "keyed" BENCH_BUILD, ALL_PATTERNS, keyed_init, keyed_offer, priqueue_pass },
+#ifndef PRIQUEUE_CONCURRENT
+	{ "bucket", (1U << PATTERN_FIFO) | (1U << PATTERN_FEW), NULL, NULL, buckets_pass },
+#endif
+};
+
+
+int main(int argc, char **argv)
+{
+	int c, b, pattern, n, op;
+	long min_size = 100, max_size = 10000000;
+
+	while ((c = getopt(argc, argv, "m:n:")) != -1)
+	{
+		switch (c)
+		{
+			case 'm':
+				max_size = atol(optarg);
+				break;
+
+			case 'n':
+				min_size = atol(optarg);
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (min_size <= 0 || max_size < min_size)
+	{
+		fprintf(stderr, "Options -n and -m require positive sizes, smallest first.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	bench_item_t *items = malloc(max_size * sizeof(bench_item_t));
+	bench_item_t *spares = malloc(max_size * sizeof(bench_item_t));
+	int *handles = malloc(max_size * sizeof(int));
+
+	printf("%-14s %-7s %9s %-7s %10s %14s\n", "backend", "pattern", "size", "op", "ns/op", "allocs/pass");
+
+	for (b = 0; b < sizeof(backends) / sizeof(backends[0]); b++)
+	{
+		for (pattern = 0; pattern < PATTERN_COUNT; pattern++)
+		{
+			if (!(backends[b].patterns & (1U << pattern)))
+				continue;
+
+			for (n = min_size; n <= max_size; n *= 10)
+			{
+				bench_result_t results[OP_COUNT];
+				unsigned int seed = n;
+				int pass, passes = (n < PASS_OPERATIONS) ? PASS_OPERATIONS / n : 1;
+
+				memset(results, 0, sizeof(results));
+				fill_keys(items, n, pattern, &seed);
+				fill_keys(spares, n, pattern, &seed);
+
+				for (pass = 0; pass < passes; pass++)
+					backends[b].pass(&backends[b], items, spares, handles, n, results);
+
+				for (op = 0; op < OP_COUNT; op++)
+				{
+					if (results[op].operations == 0)
+						continue;
+
+					printf("%-14s %-7s %9d %-7s %10.1f %14.1f\n", backends[b].name, pattern_names[pattern], n, op_names[op],
+					       results[op].seconds * 1e9 / results[op].operations, (double)results[op].allocations / passes);
+				}
+				fflush(stdout);
+
+				if (n > max_size / 10)
+					break;
+			}
+		}
+	}
+
+	free(items);
+	free(spares);
+	free(handles);
+	return 0;
+}
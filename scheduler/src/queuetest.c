@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include "libpriqueue/libpriqueue.h"
 
@@ -65,6 +66,57 @@ int main()
 		printf("%d ", *((int *)priqueue_at(&q2, i)) );
 	printf("\n");
 
+	/* Reprioritize and cancel entries through their handles. */
+	int h10 = priqueue_offer(&q2, &values[10]);
+	int h40 = priqueue_offer(&q2, &values[40]);
+	values[40] = 5;
+	priqueue_update(&q2, h40);
+	printf("Elements after update (expected 30 20 10 10 5): ");
+	for (i = 0; i < priqueue_size(&q2); i++)
+		printf("%d ", *((int *)priqueue_at(&q2, i)) );
+	printf("\n");
+
+	void *removed = priqueue_remove_handle(&q2, h10);
+	printf("Removed by handle: %d (expected 10).\n", *((int *)removed));
+	printf("Total elements: %d (expected 4).\n", priqueue_size(&q2));
+	printf("Stale handle removed: %s (expected NULL).\n", priqueue_remove_handle(&q2, h10) ? "not NULL" : "NULL");
+
+	/* A keyed queue orders by the key it is given, not the value. */
+	priqueue_t q3;
+	priqueue_init_keyed(&q3);
+	priqueue_offer_key(&q3, &values[1], 30);
+	int h2 = priqueue_offer_key(&q3, &values[2], 10);
+	priqueue_offer_key(&q3, &values[3], 20);
+	priqueue_offer_key(&q3, &values[4], 20);
+	priqueue_update_key(&q3, h2, 40);
+	printf("Elements in keyed queue (expected 3 4 1 2): ");
+	while (priqueue_size(&q3) > 0)
+		printf("%d ", *((int *)priqueue_poll(&q3)) );
+	printf("\n");
+
+	/* A batch comes out as if every element had been offered on its own. */
+	void *batch[6] = { &values[5], &values[6], &values[7], &values[8], &values[9], &values[10] };
+	unsigned long long batch_keys[6] = { 5, 1, 5, 3, 1, 0 };
+	priqueue_offer_key(&q3, &values[11], 2);
+	priqueue_offer_keys(&q3, batch, batch_keys, 6, NULL);
+	printf("Elements in batched queue (expected 10 6 9 11 8 5 7): ");
+	while (priqueue_size(&q3) > 0)
+		printf("%d ", *((int *)priqueue_poll(&q3)) );
+	printf("\n");
+
+	/* Ties keep their order when the sequence numbers run out and start over. */
+	q3.next_seq = UINT_MAX - 2;
+	priqueue_offer_key(&q3, &values[1], 7);
+	priqueue_offer_key(&q3, &values[2], 7);
+	priqueue_offer_key(&q3, &values[3], 7);
+	priqueue_offer_keys(&q3, batch, batch_keys, 6, NULL);
+	priqueue_offer_key(&q3, &values[4], 7);
+	printf("Elements after renumbering (expected 10 6 9 8 5 7 1 2 3 4): ");
+	while (priqueue_size(&q3) > 0)
+		printf("%d ", *((int *)priqueue_poll(&q3)) );
+	printf("\n");
+
+	priqueue_destroy(&q3);
 	priqueue_destroy(&q2);
 	priqueue_destroy(&q);
 
@@ -7,75 +7,77 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
-#include <assert.h>
+#include <getopt.h>
 
 #include "libscheduler/libscheduler.h"
+#include "libsimulator/libsimulator.h"
 
 
-typedef struct _simulator_job_list_t
-{
-	int job_id, arrival_time, run_time, priority;
-	int core_id, arrived;
-} simulator_job_list_t;
-
 void print_usage(char *program_name)
 {
-	fprintf(stderr, "Usage: %s -c <cores> -s <scheme> <input file>\n", program_name);
+	fprintf(stderr, "Usage: %s [-e] [-q] [-S] [-p] [-l] [--checkpoint-every <time>] [--checkpoint <file>]\n", program_name);
+	fprintf(stderr, "       [--restore <file>] [--topology <cores>,<sockets>] [--migration-penalty <socket>,<node>]\n");
+	fprintf(stderr, "       [--event-log <file>] [--event-format <format>] -c <cores> -s <scheme> <input file>\n");
 	fprintf(stderr, "       %s -c 2 -s fcfs examples/proc1.csv\n", program_name);
 	fprintf(stderr, "\n");
-	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#\n");
-}
-
-int set_active_job(int job_id, int core_id, simulator_job_list_t *jobs, int active_jobs)
-{
-	int i;
-	for (i = 0; i < active_jobs; i++)
-	{
-		if (jobs[i].job_id == job_id && jobs[i].arrived)
-		{
-			jobs[i].core_id = core_id;
-			return 1;
-		}
-	}
-
-	return 0;
+	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#, mlfq[#], edf, llf\n");
+	fprintf(stderr, "(mlfq takes the quantum of its top level, %d by default)\n", MLFQ_DEFAULT_QUANTUM);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "A job file may give each job a deadline in a fourth column, which\n");
+	fprintf(stderr, "edf and llf schedule by; missed deadlines are reported for any scheme.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -e  jump from event to event instead of stepping every time unit;\n");
+	fprintf(stderr, "      the per-time-unit core listing is not printed\n");
+	fprintf(stderr, "  -q  print only the final averages and counters; no trace and no\n");
+	fprintf(stderr, "      timing diagram\n");
+	fprintf(stderr, "  -S  stream the jobs in as they arrive instead of loading the whole\n");
+	fprintf(stderr, "      file first (implies -e); the file must be sorted by arrival time,\n");
+	fprintf(stderr, "      and simultaneous events are taken in file order\n");
+	fprintf(stderr, "  -p  give every core its own run queue; a core with an empty queue\n");
+	fprintf(stderr, "      steals from the longest one\n");
+	fprintf(stderr, "  -l  also print percentiles of the waiting, turnaround and response\n");
+	fprintf(stderr, "      times\n");
+	fprintf(stderr, "  --checkpoint-every <time>\n");
+	fprintf(stderr, "      save the whole run every <time> time units (implies -e, and\n");
+	fprintf(stderr, "      not with -S), each checkpoint replacing the last\n");
+	fprintf(stderr, "  --checkpoint <file>\n");
+	fprintf(stderr, "      where checkpoints are saved (default: <input file>.checkpoint)\n");
+	fprintf(stderr, "  --restore <file>\n");
+	fprintf(stderr, "      carry on from a checkpoint of a run of the same input file with\n");
+	fprintf(stderr, "      the same options (implies -e, and not with -S)\n");
+	fprintf(stderr, "  --topology <cores>,<sockets>\n");
+	fprintf(stderr, "      group the cores into sockets of <cores> cores and nodes of\n");
+	fprintf(stderr, "      <sockets> sockets, and report how often jobs changed cores,\n");
+	fprintf(stderr, "      sockets and nodes; with -p, cores steal from their own socket\n");
+	fprintf(stderr, "      and node first\n");
+	fprintf(stderr, "  --migration-penalty <socket>,<node>\n");
+	fprintf(stderr, "      with --topology, make a job that moves to another socket run\n");
+	fprintf(stderr, "      <socket> time units longer, or <node> if it changes nodes\n");
+	fprintf(stderr, "  --event-log <file>\n");
+	fprintf(stderr, "      also write every arrival, start, preemption, quantum expiry and\n");
+	fprintf(stderr, "      finish, with the time, job, core and queue length, to <file>\n");
+	fprintf(stderr, "  --event-format <format>\n");
+	fprintf(stderr, "      the --event-log format: binary, csv or ndjson (default: binary)\n");
 }
 
-void print_available_jobs(simulator_job_list_t *jobs, int active_jobs)
+// Add a record to the event log, if there is one.
+void log_tick_event(simulator_event_log_t *log, int time, int event, int job_id, int core_id, int jobs_alive, int *core_job, int cores)
 {
-	printf("Active jobs are: ");
+	int i, cores_working = 0;
 
-	int i, first = 1;
-	for (i = 0; i < active_jobs; i++)
-	{
-		if (jobs[i].arrived)
-		{
-			if (first)
-			{
-				printf("%d", jobs[i].job_id);
-				first = 0;
-			}
-			else
-				printf(", %d", jobs[i].job_id);
-		}
-	}
+	if (log == NULL)
+		return;
 
-	if (!first)
-		printf("\n");
+	for (i = 0; i < cores; i++)
+		if (core_job[i] != -1)
+			cores_working++;
+	event_log_write(log, time, event, job_id, core_id, jobs_alive - cores_working);
 }
 
-void print_available_cores(int cores)
+void print_percentiles(const char *name, int (*percentile)(scheduler_t *, double), scheduler_t *scheduler)
 {
-	printf("Active cores are: ");
-
-	int i;
-	for (i = 0; i < cores; i++)
-	{
-		if (i == cores - 1)
-			printf("%d\n", i);
-		else
-			printf("%d, ", i);
-	}
+	printf("%s Percentiles: p50=%d p90=%d p99=%d p99.9=%d max=%d\n", name, percentile(scheduler, 50), percentile(scheduler, 90),
+	       percentile(scheduler, 99), percentile(scheduler, 99.9), percentile(scheduler, 100));
 }
 
 
@@ -83,12 +85,28 @@ int main(int argc, char **argv)
 {
 	int c;
 	int cores = 0, scheme = -1, quantum = 0;
+	int event_driven = 0, quiet = 0, stream = 0, run_queues = 0, percentiles = 0;
 	char *file_name;
+	simulator_checkpoint_t checkpoint = { 0, NULL, NULL };
+	int cores_per_socket = 0, sockets_per_node = 0, socket_penalty = 0, node_penalty = 0;
+	char *event_log_name = NULL;
+	int event_log_format = EVENT_LOG_BINARY;
+
+	static const struct option long_options[] = {
+		{ "checkpoint-every", required_argument, NULL, 'k' },
+		{ "checkpoint", required_argument, NULL, 'K' },
+		{ "restore", required_argument, NULL, 'r' },
+		{ "topology", required_argument, NULL, 't' },
+		{ "migration-penalty", required_argument, NULL, 'm' },
+		{ "event-log", required_argument, NULL, 'L' },
+		{ "event-format", required_argument, NULL, 'F' },
+		{ NULL, 0, NULL, 0 }
+	};
 
 	/*
 	 * Parse command line options.
 	 */
-	while ((c = getopt(argc, argv, "c:s:")) != -1)
+	while ((c = getopt_long(argc, argv, "c:s:eqSpl", long_options, NULL)) != -1)
 	{
 		switch (c)
 		{
@@ -109,6 +127,20 @@ int main(int argc, char **argv)
 				else if (strcasecmp(optarg, "PSJF") == 0) { scheme = PSJF; }
 				else if (strcasecmp(optarg, "PRI") == 0) { scheme = PRI; }
 				else if (strcasecmp(optarg, "PPRI") == 0) { scheme = PPRI; }
+				else if (strcasecmp(optarg, "EDF") == 0) { scheme = EDF; }
+				else if (strcasecmp(optarg, "LLF") == 0) { scheme = LLF; }
+				else if (strncasecmp(optarg, "MLFQ", 4) == 0)
+				{
+					scheme = MLFQ;
+					quantum = (optarg[4] != '\0') ? atoi(optarg + 4) : MLFQ_DEFAULT_QUANTUM;
+
+					if (quantum <= 0)
+					{
+						fprintf(stderr, "Option -s <scheme> requires a positive number for the base quantum of MLFQ. (Eg: -s MLFQ2)\n");
+						print_usage(argv[0]);
+						return 1;
+					}
+				}
 				else if (strncasecmp(optarg, "RR", 2) == 0)
 				{
 					scheme = RR;
@@ -123,6 +155,82 @@ int main(int argc, char **argv)
 				}
 				break;
 
+			case 'e':
+				event_driven = 1;
+				break;
+
+			case 'q':
+				quiet = 1;
+				break;
+
+			case 'S':
+				stream = 1;
+				event_driven = 1;
+				break;
+
+			case 'p':
+				run_queues = 1;
+				break;
+
+			case 'l':
+				percentiles = 1;
+				break;
+
+			case 'k':
+				checkpoint.every = atoi(optarg);
+				event_driven = 1;
+
+				if (checkpoint.every <= 0)
+				{
+					fprintf(stderr, "Option --checkpoint-every <time> requires a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'K':
+				checkpoint.file_name = optarg;
+				break;
+
+			case 'r':
+				checkpoint.restore = optarg;
+				event_driven = 1;
+				break;
+
+			case 't':
+				if (sscanf(optarg, "%d,%d", &cores_per_socket, &sockets_per_node) != 2 || cores_per_socket <= 0 || sockets_per_node <= 0)
+				{
+					fprintf(stderr, "Option --topology <cores>,<sockets> requires two positive numbers.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'L':
+				event_log_name = optarg;
+				break;
+
+			case 'F':
+				if (strcasecmp(optarg, "binary") == 0) { event_log_format = EVENT_LOG_BINARY; }
+				else if (strcasecmp(optarg, "csv") == 0) { event_log_format = EVENT_LOG_CSV; }
+				else if (strcasecmp(optarg, "ndjson") == 0) { event_log_format = EVENT_LOG_NDJSON; }
+				else
+				{
+					fprintf(stderr, "Option --event-format <format> takes binary, csv or ndjson.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'm':
+				if (sscanf(optarg, "%d,%d", &socket_penalty, &node_penalty) != 2 || socket_penalty < 0 || node_penalty < 0)
+				{
+					fprintf(stderr, "Option --migration-penalty <socket>,<node> requires two numbers of at least 0.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
 			case '?':
 				print_usage(argv[0]);
 				return 1;
@@ -156,131 +264,175 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
-
-	/*
-	 * Open the file, read the file, and populate the jobs data structure.
-	 */
-	FILE *file = fopen(file_name, "r");
-	if (file == NULL)
+	if ((socket_penalty > 0 || node_penalty > 0) && cores_per_socket == 0)
 	{
-		fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
-		return 2;
+		fprintf(stderr, "Option --migration-penalty requires --topology.\n");
+		print_usage(argv[0]);
+		return 1;
 	}
 
+	if (stream && (checkpoint.every > 0 || checkpoint.restore != NULL))
+	{
+		fprintf(stderr, "Options --checkpoint-every and --restore can not be used with -S.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
 
-	int job_id = 0;
-	int jobs_ct = 10;
-	simulator_job_list_t* jobs = malloc(jobs_ct * sizeof(simulator_job_list_t));
-
-	char line[1024 + 1];
-	fgets(line, 1024, file);  // Ignore the first (header) line
-	while (fgets(line, 1024, file) != NULL)
+	char *default_checkpoint = NULL;
+	if (checkpoint.every > 0 && checkpoint.file_name == NULL)
 	{
-		char *arrival_time = strtok(line, ",");
-		char *run_time = strtok(NULL, ",");
-		char *priority = strtok(NULL, ",");
+		default_checkpoint = malloc(strlen(file_name) + sizeof(".checkpoint"));
+		sprintf(default_checkpoint, "%s.checkpoint", file_name);
+		checkpoint.file_name = default_checkpoint;
+	}
 
-		if (arrival_time != NULL && run_time != NULL && priority != NULL)
-		{
-			if (job_id == jobs_ct)
-			{
-				jobs_ct *= 2;
-				jobs = realloc(jobs, jobs_ct * sizeof(simulator_job_list_t));
 
-				if (!jobs)
-				{
-					fprintf(stderr, "Out of memory.\n");
-					return 2;
-				}
-			}
+	/*
+	 * Open the file, read the file, and populate the jobs data structure.
+	 */
+	simulator_job_list_t *jobs = NULL;
+	int *position = NULL;
+	int job_count = 0, i, j, status;
+	simulator_reader_t reader;
 
-			jobs[job_id].job_id = job_id;
-			jobs[job_id].arrival_time = atoi(arrival_time);
-			jobs[job_id].run_time = atoi(run_time);
-			jobs[job_id].priority = atoi(priority);
-			jobs[job_id].core_id = -1;
-			jobs[job_id].arrived = 0;
+	if (stream)
+		status = reader_open(&reader, file_name);
+	else
+		status = simulator_load_jobs(file_name, &jobs, &position, &job_count);
 
-			job_id++;
-		}
-		else
-		{
-			fprintf(stderr, "Illegal file format.\n");
-			return 2;
-		}
-	}
+	if (status != 0)
+		return status;
 
-	fclose(file);
+	simulator_event_log_t event_log, *log = NULL;
+	if (event_log_name != NULL)
+	{
+		if ((status = event_log_open(&event_log, event_log_name, event_log_format)) != 0)
+			return status;
+		log = &event_log;
+	}
 
 
 	/*
 	 * Run the simulation.
 	 */
 
-	printf("Loaded %d core(s) and %d job(s) using ", cores, job_id);
+	if (stream)
+		printf("Loaded %d core(s) and streaming jobs using ", cores);
+	else
+		printf("Loaded %d core(s) and %d job(s) using ", cores, job_count);
 	if (scheme == FCFS) { printf("First Come First Served (FCFS)"); }
 	else if (scheme == SJF) { printf("Non-preemptive Shortest Job First (SJF)"); }
 	else if (scheme == PSJF) { printf("Preemptive Shortest Job First (PSJF)"); }
 	else if (scheme == PRI) { printf("Non-preemptive Priority (PRI)"); }
 	else if (scheme == PPRI) { printf("Preemptive Priority (PPRI)"); }
 	else if (scheme == RR) { printf("Round Robin (RR) with a quantum of %d", quantum); }
+	else if (scheme == MLFQ) { printf("Multilevel Feedback Queue (MLFQ) with a base quantum of %d", quantum); }
+	else if (scheme == EDF) { printf("Preemptive Earliest Deadline First (EDF)"); }
+	else if (scheme == LLF) { printf("Preemptive Least Laxity First (LLF)"); }
 	printf(" scheduling...\n\n");
 
-	scheduler_start_up(cores, scheme);
+	scheduler_t *scheduler = scheduler_create_with_capacity(cores, scheme, job_count);
+	if (scheme == MLFQ)
+		scheduler_set_mlfq_r(scheduler, MLFQ_DEFAULT_LEVELS, quantum, MLFQ_DEFAULT_BOOST);
+	if (run_queues)
+		scheduler_use_run_queues_r(scheduler);
+	if (cores_per_socket > 0)
+		scheduler_set_topology_r(scheduler, cores_per_socket, sockets_per_node, socket_penalty, node_penalty);
 
 
-	int time = 0, i, j;
-	int active_jobs = job_id, jobs_alive = 0;
+	int time = 0;
+	int active_jobs = job_count, jobs_alive = 0, next_arrival = 0;
 
 	int *quantum_clock = malloc(cores * sizeof(int));
-	char **core_timing_diagram = malloc(cores * sizeof(char *));
-	int core_timing_diagram_size = 1024;
+	int *core_job = malloc(cores * sizeof(int));  // jobs[] index running on each core, -1 if idle
+	int *finishing = malloc(cores * sizeof(int));
+	int *arriving = malloc((job_count + 1) * sizeof(int));
+
+	simulator_scan_order_t order;
+	scan_order_init(&order, job_count);
+	simulator_diagram_t *core_timing_diagram = quiet ? NULL : malloc(cores * sizeof(simulator_diagram_t));
 
 	for (i = 0; i < cores; i++)
 	{
 		quantum_clock[i] = -1;
-		core_timing_diagram[i] = malloc(core_timing_diagram_size + 1);
-		core_timing_diagram[i][0] = '\0';
+		core_job[i] = -1;
+	}
+
+	for (i = 0; !quiet && i < cores; i++)
+		diagram_init(&core_timing_diagram[i]);
+
+	if (event_driven)
+	{
+		if (stream)
+			status = simulate_stream(scheduler, &reader, cores, scheme, quantum, quantum_clock, core_timing_diagram, !quiet, &time, &job_count, log);
+		else
+			status = simulate_events(scheduler, jobs, position, &order, job_count, cores, scheme, quantum, quantum_clock, core_timing_diagram, !quiet, &time,
+			                         &checkpoint, log);
+		if (status != 0)
+		{
+			if (log != NULL)
+				event_log_close(log);
+			return status;
+		}
+
+		active_jobs = 0;  // skip the tick loop below
 	}
 
 	while (active_jobs > 0)
 	{
-		printf("=== [TIME %d] ===\n", time);
+		if (!quiet)
+			printf("=== [TIME %d] ===\n", time);
 
 		/*
 		 * 1. Check if any jobs finished in the last time unit.
 		 */
-		for (i = 0; i < active_jobs; i++)
+		int finishing_count = 0;
+		for (i = 0; i < cores; i++)
+			if (core_job[i] != -1 && jobs[core_job[i]].run_time == 0)
+				scan_order_insert(&order, finishing, finishing_count++, jobs[core_job[i]].job_id);
+
+		while (finishing_count > 0)
 		{
-			if (jobs[i].run_time == 0)
+			// Notify the scheduler has finished
+			simulator_job_list_t *job = &jobs[position[scan_order_next_finished(&order, finishing, &finishing_count)]];
+			int job_id = job->job_id;
+			int core_id = job->core_id;
+			int new_job_id = scheduler_job_finished_r(scheduler, core_id, job_id, time);
+
+			if (scheme_has_quantum(scheme))
+				quantum_clock[core_id] = core_quantum(scheduler, scheme, quantum, core_id);
+
+			// Mark the job finished, decrease the number of active jobs
+			job->finished = 1;
+			job->core_id = -1;
+			core_job[core_id] = -1;
+			active_jobs--;
+			jobs_alive--;
+
+			// Set the new job
+			if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, position, job_count) )
 			{
-				// Notify the scheduler has finished
-				int job_id = jobs[i].job_id;
-				int core_id = jobs[i].core_id;
-				int new_job_id = scheduler_job_finished(jobs[i].core_id, jobs[i].job_id, time);
-
-				if (scheme == RR)
-					quantum_clock[jobs[i].core_id] = quantum;
-
-				// Delete the finished jobs, decrease the number of active jobs
-				if (i != active_jobs - 1)
-					memcpy(&jobs[i], &jobs[active_jobs - 1], sizeof(simulator_job_list_t));
-				active_jobs--;
-				jobs_alive--;
-				i--;
-
-				// Set the new job
-				if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
+				printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
+				print_available_jobs(jobs, job_count);
+				return 3;
+			}
+			else
+			{
+				if (new_job_id != -1)
 				{
-					printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
-					print_available_jobs(jobs, active_jobs);
-					return 3;
+					core_job[core_id] = position[new_job_id];
+					jobs[core_job[core_id]].run_time += scheduler_core_penalty_r(scheduler, core_id);
 				}
-				else
+
+				if (!quiet)
 				{
 					printf("Job %d, running on core %d, finished. Core %d is now running job %d.\n", job_id, core_id, core_id, new_job_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
+					printf("  Queue: "); scheduler_show_queue_r(scheduler); printf("\n\n");
 				}
+
+				log_tick_event(log, time, EVENT_FINISH, job_id, core_id, jobs_alive, core_job, cores);
+				if (new_job_id != -1)
+					log_tick_event(log, time, EVENT_RUN, new_job_id, core_id, jobs_alive, core_job, cores);
 			}
 		}
 
@@ -293,40 +445,46 @@ int main(int argc, char **argv)
 		/*
 		 * 2. Check of any quantums expired in the last time unit.
 		 */
-		if (scheme == RR)
+		if (scheme_has_quantum(scheme))
 		{
 			for (i = 0; i < cores; i++)
 			{
-				if (quantum_clock[i] == 0)
+				if (quantum_clock[i] == 0 && core_job[i] != -1)
 				{
-					for (j = 0; j < active_jobs; j++)
+					// Notify the scheduler the quantum has expired
+					int core_id = i;
+					int old_job_id = jobs[core_job[i]].job_id;
+					int new_job_id = scheduler_quantum_expired_r(scheduler, core_id, time);
+
+					jobs[core_job[i]].core_id = -1;
+					core_job[i] = -1;
+
+					quantum_clock[core_id] = core_quantum(scheduler, scheme, quantum, core_id);
+
+					// Set the new job
+					if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, position, job_count) )
+					{
+						printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
+						print_available_jobs(jobs, job_count);
+						return 3;
+					}
+					else
 					{
-						if (jobs[j].core_id == i)
+						if (new_job_id != -1)
 						{
-							// Notify the scheduler the quantum has expired
-							int core_id = jobs[j].core_id;
-							int old_job_id = jobs[j].job_id;
-							int new_job_id = scheduler_quantum_expired(jobs[j].core_id, time);
-
-							jobs[j].core_id = -1;
-
-							quantum_clock[core_id] = quantum;
-
-							// Set the new job
-							if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
-							{
-								printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
-								print_available_jobs(jobs, active_jobs);
-								return 3;
-							}
-							else
-							{
-								printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", old_job_id, core_id, core_id, new_job_id);
-								printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-							}
-
-							break;
+							core_job[core_id] = position[new_job_id];
+							jobs[core_job[core_id]].run_time += scheduler_core_penalty_r(scheduler, core_id);
 						}
+
+						if (!quiet)
+						{
+							printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", old_job_id, core_id, core_id, new_job_id);
+							printf("  Queue: "); scheduler_show_queue_r(scheduler); printf("\n\n");
+						}
+
+						log_tick_event(log, time, EVENT_EXPIRE, old_job_id, core_id, jobs_alive, core_job, cores);
+						if (new_job_id != -1)
+							log_tick_event(log, time, EVENT_RUN, new_job_id, core_id, jobs_alive, core_job, cores);
 					}
 				}
 			}
@@ -336,43 +494,59 @@ int main(int argc, char **argv)
 		/*
 		 * 3. Check for any new jobs that arrive in this time unit
 		 */
-		for (i = 0; i < active_jobs; i++)
+		int arriving_count = 0;
+		for (; next_arrival < job_count && jobs[next_arrival].arrival_time == time; next_arrival++)
+			scan_order_insert(&order, arriving, arriving_count++, jobs[next_arrival].job_id);
+
+		for (j = 0; j < arriving_count; j++)
 		{
-			if (jobs[i].arrival_time == time)
-			{
-				int new_job_core_id = scheduler_new_job(jobs[i].job_id, time, jobs[i].run_time, jobs[i].priority);
-				jobs[i].arrived = 1;
-				jobs_alive++;
+			i = position[arriving[j]];
+
+			int new_job_core_id = scheduler_new_deadline_job_r(scheduler, jobs[i].job_id, time, jobs[i].run_time, jobs[i].priority, jobs[i].deadline);
+			jobs[i].arrived = 1;
+			jobs_alive++;
 
-				if (new_job_core_id >= 0 && new_job_core_id < cores)
+			if (new_job_core_id >= 0 && new_job_core_id < cores)
+			{
+				if (!quiet)
 				{
 					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
 							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id, new_job_core_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
+					printf("  Queue: "); scheduler_show_queue_r(scheduler); printf("\n\n");
+				}
 
-					// Find if anyone is currently using the core.
-					for (j = 0; j < active_jobs; j++)
-						if (jobs[j].core_id == new_job_core_id)
-							jobs[j].core_id = -1;
+				// Find if anyone is currently using the core.
+				int preempted = core_job[new_job_core_id];
+				if (preempted != -1)
+					jobs[preempted].core_id = -1;
 
-					// Assign the core to the new job
-					jobs[i].core_id = new_job_core_id;
+				// Assign the core to the new job
+				jobs[i].core_id = new_job_core_id;
+				core_job[new_job_core_id] = i;
 
-					if (scheme == RR)
-						quantum_clock[new_job_core_id] = quantum;
-				}
-				else if (new_job_core_id == -1)
+				log_tick_event(log, time, EVENT_ARRIVE, jobs[i].job_id, new_job_core_id, jobs_alive, core_job, cores);
+				if (preempted != -1)
+					log_tick_event(log, time, EVENT_PREEMPT, jobs[preempted].job_id, new_job_core_id, jobs_alive, core_job, cores);
+				log_tick_event(log, time, EVENT_RUN, jobs[i].job_id, new_job_core_id, jobs_alive, core_job, cores);
+
+				if (scheme_has_quantum(scheme))
+					quantum_clock[new_job_core_id] = core_quantum(scheduler, scheme, quantum, new_job_core_id);
+			}
+			else if (new_job_core_id == -1)
+			{
+				if (!quiet)
 				{
 					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
 							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-				}
-				else
-				{
-					printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", new_job_core_id);
-					print_available_cores(cores);
-					return 3;
+					printf("  Queue: "); scheduler_show_queue_r(scheduler); printf("\n\n");
 				}
+				log_tick_event(log, time, EVENT_ARRIVE, jobs[i].job_id, -1, jobs_alive, core_job, cores);
+			}
+			else
+			{
+				printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", new_job_core_id);
+				print_available_cores(cores);
+				return 3;
 			}
 		}
 
@@ -380,74 +554,50 @@ int main(int argc, char **argv)
 		/*
 		 * 4. Run the time unit.
 		 */
-		char time_string[cores][11];
 		int cores_working = 0;
 
 		for (i = 0; i < cores; i++)
-			time_string[i][0] = '\0';
-
-		for (i = 0; i < active_jobs; i++)
 		{
-			if (jobs[i].core_id != -1)
+			int job_id = -1;
+
+			if (core_job[i] != -1)
 			{
 				cores_working++;
-				jobs[i].run_time--;
-				quantum_clock[jobs[i].core_id]--;
-
-				assert(time_string[jobs[i].core_id][0] == '\0');
+				jobs[core_job[i]].run_time--;
+				quantum_clock[i]--;
 
-				if (jobs[i].job_id < 10)
-					sprintf(time_string[jobs[i].core_id], "%d", jobs[i].job_id);
-				else if (jobs[i].job_id < 10 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 + 'a');
-				else if (jobs[i].job_id < 10 + 26 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 - 26 + 'A');
-				else
-					snprintf(time_string[jobs[i].core_id], 10, "(%d)", jobs[i].job_id);
+				job_id = jobs[core_job[i]].job_id;
 			}
-		}
-
-		for (i = 0; i < cores; i++)
-		{
-			// If the core is idle, print a '-'
-			if (time_string[i][0] == '\0')
-				strcpy(time_string[i], "-");
 
-			// Ensure we have enough memory
-			while (strlen(core_timing_diagram[i]) + strlen(time_string[i]) >= (unsigned int)core_timing_diagram_size)
+			if (!quiet && !diagram_append(&core_timing_diagram[i], job_id, 1))
 			{
-				core_timing_diagram_size *= 2;
-
-				for (j = 0; j < cores; j++)
-				{
-					core_timing_diagram[j] = realloc(core_timing_diagram[j], core_timing_diagram_size + 1);
-
-					if (core_timing_diagram[j] == NULL)
-					{
-						fprintf(stderr, "Out of memory.\n");
-						return 3;
-					}
-				}
+				fprintf(stderr, "Out of memory.\n");
+				return 3;
 			}
-
-			strcat( core_timing_diagram[i], time_string[i] );
 		}
 
 
 		/*
 		 * 5. Print data!
 		 */
-		printf("At the end of time unit %d...\n", time);
+		if (!quiet)
+		{
+			printf("At the end of time unit %d...\n", time);
 
-		for (i = 0; i < cores; i++)
-			printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
+			for (i = 0; i < cores; i++)
+			{
+				printf("  Core %2d: ", i);
+				diagram_print(&core_timing_diagram[i]);
+				printf("\n");
+			}
 
-		printf("\n");
+			printf("\n");
 
-		printf("  Queue: ");
-		scheduler_show_queue();
-		printf("\n");
-		printf("\n");
+			printf("  Queue: ");
+			scheduler_show_queue_r(scheduler);
+			printf("\n");
+			printf("\n");
+		}
 
 
 		/*
@@ -458,7 +608,7 @@ int main(int argc, char **argv)
 		if (jobs_alive > 0 && cores_working == 0)
 		{
 			printf("All cores are idle and at least one job remains unscheduled.\n");
-			print_available_jobs(jobs, active_jobs);
+			print_available_jobs(jobs, job_count);
 			return 3;
 		}
 
@@ -470,23 +620,67 @@ int main(int argc, char **argv)
 	}
 
 
-	printf("FINAL TIMING DIAGRAM:\n");
-	for (i = 0; i < cores; i++)
-		printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
+	if (quiet)
+		printf("Finished %d job(s) at time %d.\n", job_count, time);
+	else
+	{
+		printf("FINAL TIMING DIAGRAM:\n");
+		for (i = 0; i < cores; i++)
+		{
+			printf("  Core %2d: ", i);
+			diagram_print(&core_timing_diagram[i]);
+			printf("\n");
+		}
+	}
 
 	printf("\n");
-	printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
-	printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
-	printf("Average Response Time: %.2f\n", scheduler_average_response_time());
+	printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time_r(scheduler));
+	printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time_r(scheduler));
+	printf("Average Response Time: %.2f\n", scheduler_average_response_time_r(scheduler));
+	if (scheduler_deadline_jobs_r(scheduler) > 0)
+	{
+		printf("Deadlines Missed: %d of %d\n", scheduler_deadline_misses_r(scheduler), scheduler_deadline_jobs_r(scheduler));
+		printf("Average Tardiness: %.2f\n", scheduler_average_tardiness_r(scheduler));
+		printf("Maximum Tardiness: %d\n", scheduler_max_tardiness_r(scheduler));
+	}
+	if (run_queues)
+		printf("Jobs Stolen: %d\n", scheduler_steal_count_r(scheduler));
+	if (cores_per_socket > 0)
+	{
+		printf("Migrations: %d within a socket, %d across sockets, %d across nodes\n", scheduler_migrations_r(scheduler, MIGRATION_CORE),
+		       scheduler_migrations_r(scheduler, MIGRATION_SOCKET), scheduler_migrations_r(scheduler, MIGRATION_NODE));
+		printf("Migration Penalty: %d\n", scheduler_migration_time_r(scheduler));
+	}
+
+	if (percentiles)
+	{
+		printf("\n");
+		print_percentiles("Waiting Time", scheduler_waiting_time_percentile_r, scheduler);
+		print_percentiles("Turnaround Time", scheduler_turnaround_time_percentile_r, scheduler);
+		print_percentiles("Response Time", scheduler_response_time_percentile_r, scheduler);
+	}
+
+	scheduler_dump_stats_r(scheduler);
+	scheduler_destroy(scheduler);
 
-	scheduler_clean_up();
+	status = 0;
+	if (log != NULL)
+		status = event_log_close(log);
 
 
 	free(quantum_clock);
-	for (i=0; i < cores; i++)
-		free(core_timing_diagram[i]);
+	free(core_job);
+	free(finishing);
+	free(arriving);
+	scan_order_destroy(&order);
+	for (i=0; !quiet && i < cores; i++)
+		diagram_destroy(&core_timing_diagram[i]);
 	free(core_timing_diagram);
+	free(position);
 	free(jobs);
+	free(default_checkpoint);
+	if (stream)
+		reader_close(&reader);
 
-	return 0;
+	return status;
 }
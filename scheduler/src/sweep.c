@@ -0,0 +1,312 @@
+/** @file sweep.c
+ *
+ * Runs one job file through every combination of the schemes, core counts
+ * and RR or MLFQ quanta asked for, spread over a pool of threads, and prints one
+ * summary row per run.  The file is loaded once; each run works on its own
+ * copy of the job list and its own scheduler.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libscheduler/libscheduler.h"
+#include "libsimulator/libsimulator.h"
+
+
+typedef struct _sweep_run_t
+{
+	int scheme, quantum, cores;
+
+	float waiting_time, turnaround_time, response_time, tardiness;
+	int waiting_p99, turnaround_p99, response_p99;
+	int end_time, steals, misses;
+	double wall_ms;
+	int status;
+} sweep_run_t;
+
+typedef struct _sweep_t
+{
+	const simulator_job_list_t *jobs;  // shared by every run, never written
+	int *position;
+	int job_count;
+	int run_queues;  // give every core its own run queue
+
+	sweep_run_t *runs;
+	int run_count;
+
+	pthread_mutex_t lock;
+	int next_run;  // the next runs[] index to hand out, under lock
+} sweep_t;
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-j <threads>] [-p] -c <cores> -s <schemes> [-q <quanta>] <input file>\n", program_name);
+	fprintf(stderr, "       %s -j 8 -c 1-4 -s fcfs,sjf,rr -q 1,2,5 examples/proc1.csv\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -c  core counts to run, as a list of numbers and ranges (1,2,8-16)\n");
+	fprintf(stderr, "  -s  schemes to run: fcfs, sjf, psjf, pri, ppri, edf, llf, rr#, mlfq#, or\n");
+	fprintf(stderr, "      rr and mlfq for every -q quantum\n");
+	fprintf(stderr, "  -q  quanta to run rr, and base quanta to run mlfq, with, as a list of\n");
+	fprintf(stderr, "      numbers and ranges\n");
+	fprintf(stderr, "  -j  number of threads (default: one per online processor)\n");
+	fprintf(stderr, "  -p  give every core its own run queue, with stealing\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "One CSV row is printed per run, in the order the options list them.\n");
+}
+
+double elapsed_ms(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+void sweep_run(sweep_t *sweep, sweep_run_t *run)
+{
+	struct timespec start, end;
+	int i, cores = run->cores, job_count = sweep->job_count;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	simulator_job_list_t *jobs = malloc((job_count + 1) * sizeof(simulator_job_list_t));
+	int *quantum_clock = malloc(cores * sizeof(int));
+	simulator_scan_order_t order;
+
+	memcpy(jobs, sweep->jobs, job_count * sizeof(simulator_job_list_t));
+	for (i = 0; i < cores; i++)
+		quantum_clock[i] = -1;
+	scan_order_init(&order, job_count);
+
+	scheduler_t *scheduler = scheduler_create_with_capacity(cores, run->scheme, job_count);
+	if (run->scheme == MLFQ)
+		scheduler_set_mlfq_r(scheduler, MLFQ_DEFAULT_LEVELS, run->quantum, MLFQ_DEFAULT_BOOST);
+	if (sweep->run_queues)
+		scheduler_use_run_queues_r(scheduler);
+
+	run->status = simulate_events(scheduler, jobs, sweep->position, &order, job_count, cores, run->scheme, run->quantum, quantum_clock, NULL, 0, &run->end_time, NULL, NULL);
+	run->waiting_time = scheduler_average_waiting_time_r(scheduler);
+	run->turnaround_time = scheduler_average_turnaround_time_r(scheduler);
+	run->response_time = scheduler_average_response_time_r(scheduler);
+	run->waiting_p99 = scheduler_waiting_time_percentile_r(scheduler, 99);
+	run->turnaround_p99 = scheduler_turnaround_time_percentile_r(scheduler, 99);
+	run->response_p99 = scheduler_response_time_percentile_r(scheduler, 99);
+	run->steals = scheduler_steal_count_r(scheduler);
+	run->misses = scheduler_deadline_misses_r(scheduler);
+	run->tardiness = scheduler_average_tardiness_r(scheduler);
+
+	scheduler_destroy(scheduler);
+	scan_order_destroy(&order);
+	free(quantum_clock);
+	free(jobs);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	run->wall_ms = elapsed_ms(&start, &end);
+}
+
+void *sweep_worker(void *arg)
+{
+	sweep_t *sweep = arg;
+
+	while (1)
+	{
+		pthread_mutex_lock(&sweep->lock);
+		int next = sweep->next_run++;
+		pthread_mutex_unlock(&sweep->lock);
+
+		if (next >= sweep->run_count)
+			break;
+
+		sweep_run(sweep, &sweep->runs[next]);
+	}
+
+	return NULL;
+}
+
+
+int main(int argc, char **argv)
+{
+	int c, i, j, k, run_queues = 0;
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int *core_list = NULL, core_count = 0;
+	int *quantum_list = NULL, quantum_count = 0;
+	int *scheme_list = NULL, *scheme_quanta = NULL, scheme_count = 0;
+	char *file_name;
+
+	/*
+	 * Parse command line options.
+	 */
+	while ((c = getopt(argc, argv, "c:s:q:j:p")) != -1)
+	{
+		switch (c)
+		{
+			case 'c':
+				if (!parse_number_list(optarg, &core_list, &core_count))
+				{
+					fprintf(stderr, "Option -c <cores> requires a list of positive numbers.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 's':
+				if (!parse_scheme_list(optarg, &scheme_list, &scheme_quanta, &scheme_count))
+				{
+					fprintf(stderr, "Option -s <schemes> has an unknown scheme.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'q':
+				if (!parse_number_list(optarg, &quantum_list, &quantum_count))
+				{
+					fprintf(stderr, "Option -q <quanta> requires a list of positive numbers.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'j':
+				threads = atoi(optarg);
+
+				if (threads <= 0)
+				{
+					fprintf(stderr, "Option -j <threads> require a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'p':
+				run_queues = 1;
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (core_count == 0)
+	{
+		fprintf(stderr, "Required option -c <cores> is not present.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (scheme_count == 0)
+	{
+		fprintf(stderr, "Required option -s <schemes> is not present.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < scheme_count; i++)
+	{
+		if (scheme_has_quantum(scheme_list[i]) && scheme_quanta[i] == 0 && quantum_count == 0)
+		{
+			fprintf(stderr, "Scheme %s without a quantum requires option -q <quanta>.\n", scheme_names[scheme_list[i]]);
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind == argc - 1)
+		file_name = argv[optind];
+	else
+	{
+		fprintf(stderr, "A single input file is required.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+
+	/*
+	 * Load the jobs once, and lay out every run.
+	 */
+	sweep_t sweep;
+	simulator_job_list_t *jobs;
+
+	int status = simulator_load_jobs(file_name, &jobs, &sweep.position, &sweep.job_count);
+	if (status != 0)
+		return status;
+
+	sweep.jobs = jobs;
+	sweep.run_queues = run_queues;
+	sweep.runs = NULL;
+	sweep.run_count = 0;
+	sweep.next_run = 0;
+	pthread_mutex_init(&sweep.lock, NULL);
+
+	for (i = 0; i < scheme_count; i++)
+	{
+		int quanta = (scheme_has_quantum(scheme_list[i]) && scheme_quanta[i] == 0) ? quantum_count : 1;
+
+		for (j = 0; j < quanta; j++)
+		{
+			for (k = 0; k < core_count; k++)
+			{
+				sweep.runs = realloc(sweep.runs, (sweep.run_count + 1) * sizeof(sweep_run_t));
+
+				sweep_run_t *run = &sweep.runs[sweep.run_count++];
+				run->scheme = scheme_list[i];
+				run->quantum = !scheme_has_quantum(scheme_list[i]) ? 0 : (scheme_quanta[i] ? scheme_quanta[i] : quantum_list[j]);
+				run->cores = core_list[k];
+			}
+		}
+	}
+
+
+	/*
+	 * Run them.
+	 */
+	if (threads > sweep.run_count)
+		threads = sweep.run_count;
+
+	pthread_t *workers = malloc(threads * sizeof(pthread_t));
+	for (i = 0; i < threads; i++)
+	{
+		if (pthread_create(&workers[i], NULL, sweep_worker, &sweep) != 0)
+		{
+			fprintf(stderr, "Unable to start thread %d.\n", i);
+			threads = i;
+			break;
+		}
+	}
+
+	// Should no thread start, do the work here.
+	if (threads == 0)
+		sweep_worker(&sweep);
+
+	for (i = 0; i < threads; i++)
+		pthread_join(workers[i], NULL);
+
+
+	printf("scheme,quantum,cores,jobs,end_time,avg_waiting,avg_turnaround,avg_response,p99_waiting,p99_turnaround,p99_response,deadline_misses,avg_tardiness,steals,wall_ms,status\n");
+	for (i = 0; i < sweep.run_count; i++)
+	{
+		sweep_run_t *run = &sweep.runs[i];
+
+		printf("%s,%d,%d,%d,%d,%.2f,%.2f,%.2f,%d,%d,%d,%d,%.2f,%d,%.3f,%s\n", scheme_names[run->scheme], run->quantum, run->cores, sweep.job_count,
+				run->end_time, run->waiting_time, run->turnaround_time, run->response_time,
+				run->waiting_p99, run->turnaround_p99, run->response_p99, run->misses, run->tardiness, run->steals, run->wall_ms, run->status ? "failed" : "ok");
+
+		if (run->status)
+			status = 3;
+	}
+
+	pthread_mutex_destroy(&sweep.lock);
+	free(workers);
+	free(sweep.runs);
+	free(sweep.position);
+	free(jobs);
+	free(core_list);
+	free(quantum_list);
+	free(scheme_list);
+	free(scheme_quanta);
+
+	return status;
+}
@@ -0,0 +1,390 @@
+/** @file throughput.c
+ *
+ * Measures how many scheduling decisions per second libscheduler makes.
+ * The jobs in a file are fed straight to scheduler_new_job_r(),
+ * scheduler_job_finished_r() and scheduler_quantum_expired_r() by a small
+ * event loop of its own, with none of the simulator's printing, diagram or
+ * bookkeeping, once for every scheme and core count asked for.  Every run
+ * is made in a child process so that its peak resident set size can be
+ * reported on its own row.
+ *
+ * The loop checks for the next event by looking at every core, which is
+ * the only cost that it adds per event beyond the scheduler calls.
+ *
+ * The last column says which event paths the scheduler was built with: the
+ * ones specialized for each scheme, or with SCHEDULER_GENERIC (as
+ * throughput-generic is) the one generic copy.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "libscheduler/libscheduler.h"
+#include "libsimulator/libsimulator.h"
+
+
+#ifdef SCHEDULER_GENERIC
+#define THROUGHPUT_PATHS "generic"
+#else
+#define THROUGHPUT_PATHS "specialized"
+#endif
+
+typedef struct _throughput_core_t
+{
+	int job_id;  // -1 while idle
+	int since, finish, expire;
+} throughput_core_t;
+
+typedef struct _throughput_run_t
+{
+	int scheme, quantum, cores;
+	int batched;  // hand simultaneous arrivals over with scheduler_new_jobs_r()
+
+	long long events;
+	int end_time;
+	double seconds;
+	int status;
+} throughput_run_t;
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-c <cores>] [-s <schemes>] [-q <quantum>] [-p] [-b] <input file>\n", program_name);
+	fprintf(stderr, "       %s -c 1,4,16 -s fcfs,sjf,rr2 big.trace\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -c  core counts to run, as a list of numbers and ranges (default: 1,2,4,8)\n");
+	fprintf(stderr, "  -s  schemes to run: fcfs, sjf, psjf, pri, ppri, edf, llf, rr#, mlfq#, or\n");
+	fprintf(stderr, "      rr and mlfq with the -q quantum (default: all of them)\n");
+	fprintf(stderr, "  -q  quantum for rr and mlfq without one (default: 2)\n");
+	fprintf(stderr, "  -p  give every core its own run queue, with stealing\n");
+	fprintf(stderr, "  -b  hand simultaneous arrivals to the scheduler in one scheduler_new_jobs_r()\n");
+	fprintf(stderr, "      call; each job still counts as an event\n");
+}
+
+double elapsed_seconds(struct timespec *start, struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+// Put job_id, or nothing when it is -1, on core_id at time.
+void start_job(scheduler_t *s, throughput_run_t *run, throughput_core_t *core, int core_id, int job_id, int *remaining, int time)
+{
+	core->job_id = job_id;
+	core->since = time;
+	core->finish = (job_id != -1) ? time + remaining[job_id] : INT_MAX;
+	core->expire = INT_MAX;
+	if (job_id != -1 && scheme_has_quantum(run->scheme))
+	{
+		int quantum = core_quantum(s, run->scheme, run->quantum, core_id);
+
+		// A long MLFQ quantum is held at INT_MAX, which is never.
+		if (quantum < INT_MAX - time)
+			core->expire = time + quantum;
+	}
+}
+
+// Take the job off core, counting the time it ran against it.
+void stop_job(throughput_core_t *core, int *remaining, int time)
+{
+	remaining[core->job_id] -= time - core->since;
+	core->job_id = -1;
+}
+
+/*
+ * Run jobs[] through s from start to finish.  Returns 0, or 3 if the
+ * scheduler made an invalid choice or left a job unscheduled.
+ */
+int drive(scheduler_t *s, throughput_run_t *run, const simulator_job_list_t *jobs, int job_count)
+{
+	throughput_core_t *cores = malloc(run->cores * sizeof(throughput_core_t));
+	int *remaining = malloc(job_count * sizeof(int));
+	scheduler_job_desc_t *batch = NULL;
+	int *batch_cores = NULL, batch_capacity = 0;
+	int i, next = 0, alive = 0, status = 0;
+	int time = (job_count > 0) ? jobs[0].arrival_time : 0;
+
+	for (i = 0; i < run->cores; i++)
+		start_job(s, run, &cores[i], i, -1, remaining, 0);
+
+	while (next < job_count || alive > 0)
+	{
+		// Jobs finishing now, then quanta expiring, then arrivals, as in the simulator.
+		for (i = 0; i < run->cores; i++)
+		{
+			if (cores[i].finish != time)
+				continue;
+
+			int job_id = scheduler_job_finished_r(s, i, cores[i].job_id, time);
+			run->events++;
+			alive--;
+
+			if (job_id < -1 || job_id >= job_count)
+			{
+				fprintf(stderr, "The scheduler_job_finished() selected an invalid job (job_id == %d).\n", job_id);
+				status = 3;
+				goto done;
+			}
+			start_job(s, run, &cores[i], i, job_id, remaining, time);
+		}
+
+		for (i = 0; i < run->cores; i++)
+		{
+			if (cores[i].expire != time)
+				continue;
+
+			stop_job(&cores[i], remaining, time);
+			int job_id = scheduler_quantum_expired_r(s, i, time);
+			run->events++;
+
+			if (job_id < -1 || job_id >= job_count)
+			{
+				fprintf(stderr, "The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", job_id);
+				status = 3;
+				goto done;
+			}
+			start_job(s, run, &cores[i], i, job_id, remaining, time);
+		}
+
+		int arrivals = 0;
+		while (next + arrivals < job_count && jobs[next + arrivals].arrival_time == time)
+			arrivals++;
+
+		if (run->batched && arrivals > 0)
+		{
+			if (arrivals > batch_capacity)
+			{
+				batch_capacity = arrivals;
+				batch = realloc(batch, batch_capacity * sizeof(scheduler_job_desc_t));
+				batch_cores = realloc(batch_cores, batch_capacity * sizeof(int));
+			}
+			for (i = 0; i < arrivals; i++)
+			{
+				batch[i].job_number = jobs[next + i].job_id;
+				batch[i].running_time = jobs[next + i].run_time;
+				batch[i].priority = jobs[next + i].priority;
+				batch[i].deadline = jobs[next + i].deadline;
+			}
+			scheduler_new_jobs_r(s, batch, arrivals, time, batch_cores);
+			run->events += arrivals;
+		}
+
+		for (i = 0; i < arrivals; i++, next++)
+		{
+			const simulator_job_list_t *job = &jobs[next];
+			int core_id;
+
+			if (run->batched)
+				core_id = batch_cores[i];
+			else
+			{
+				core_id = scheduler_new_deadline_job_r(s, job->job_id, time, job->run_time, job->priority, job->deadline);
+				run->events++;
+			}
+			alive++;
+			remaining[job->job_id] = job->run_time;
+
+			if (core_id < -1 || core_id >= run->cores)
+			{
+				fprintf(stderr, "The scheduler_new_job() selected an invalid core (core_id == %d).\n", core_id);
+				status = 3;
+				goto done;
+			}
+
+			if (core_id != -1)
+			{
+				// Take the core from whoever is using it.
+				if (cores[core_id].job_id != -1)
+					stop_job(&cores[core_id], remaining, time);
+				start_job(s, run, &cores[core_id], core_id, job->job_id, remaining, time);
+			}
+		}
+
+		int next_time = (next < job_count) ? jobs[next].arrival_time : INT_MAX;
+		for (i = 0; i < run->cores; i++)
+		{
+			if (cores[i].finish < next_time)
+				next_time = cores[i].finish;
+			if (cores[i].expire < next_time)
+				next_time = cores[i].expire;
+		}
+
+		if (next_time == INT_MAX && alive > 0)
+		{
+			fprintf(stderr, "All cores are idle and at least one job remains unscheduled.\n");
+			status = 3;
+			goto done;
+		}
+
+		if (next_time != INT_MAX)
+			time = next_time;
+	}
+
+	run->end_time = time;
+
+done:
+	free(batch_cores);
+	free(batch);
+	free(remaining);
+	free(cores);
+	return status;
+}
+
+// Make the run and print its row, in a process of its own.
+int run_child(throughput_run_t *run, const simulator_job_list_t *jobs, int job_count, int run_queues)
+{
+	struct timespec start, end;
+	struct rusage usage;
+
+	run->events = 0;
+	run->end_time = 0;
+
+	scheduler_t *scheduler = scheduler_create_with_capacity(run->cores, run->scheme, job_count);
+	if (run->scheme == MLFQ)
+		scheduler_set_mlfq_r(scheduler, MLFQ_DEFAULT_LEVELS, run->quantum, MLFQ_DEFAULT_BOOST);
+	if (run_queues)
+		scheduler_use_run_queues_r(scheduler);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	run->status = drive(scheduler, run, jobs, job_count);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	run->seconds = elapsed_seconds(&start, &end);
+
+	scheduler_destroy(scheduler);
+	getrusage(RUSAGE_SELF, &usage);
+
+	printf("%-6s %7d %5d %9d %11lld %10d %9.3f %13.2f %12.1f %-6s %s\n", scheme_names[run->scheme], run->quantum, run->cores, job_count,
+	       run->events, run->end_time, run->seconds, run->events / run->seconds / 1e6, usage.ru_maxrss / 1024.0,
+	       run->status ? "failed" : "ok", THROUGHPUT_PATHS);
+	fflush(stdout);
+
+	return run->status;
+}
+
+
+int main(int argc, char **argv)
+{
+	int c, i, j, quantum = 2, run_queues = 0, batched = 0;
+	int *core_list = NULL, core_count = 0;
+	int *scheme_list = NULL, *scheme_quanta = NULL, scheme_count = 0;
+
+	while ((c = getopt(argc, argv, "c:s:q:pb")) != -1)
+	{
+		switch (c)
+		{
+			case 'c':
+				if (!parse_number_list(optarg, &core_list, &core_count))
+				{
+					fprintf(stderr, "Option -c <cores> requires a list of positive numbers.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 's':
+				if (!parse_scheme_list(optarg, &scheme_list, &scheme_quanta, &scheme_count))
+				{
+					fprintf(stderr, "Option -s <schemes> has an unknown scheme.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'q':
+				quantum = atoi(optarg);
+
+				if (quantum <= 0)
+				{
+					fprintf(stderr, "Option -q <quantum> require a positive number.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'p':
+				run_queues = 1;
+				break;
+
+			case 'b':
+				batched = 1;
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		fprintf(stderr, "A single input file is required.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (core_count == 0)
+	{
+		char default_cores[] = "1,2,4,8";
+		parse_number_list(default_cores, &core_list, &core_count);
+	}
+
+	if (scheme_count == 0)
+	{
+		char default_schemes[] = "fcfs,sjf,psjf,pri,ppri,rr,mlfq,edf,llf";
+		parse_scheme_list(default_schemes, &scheme_list, &scheme_quanta, &scheme_count);
+	}
+
+	simulator_job_list_t *jobs;
+	int *position, job_count;
+
+	int status = simulator_load_jobs(argv[optind], &jobs, &position, &job_count);
+	if (status != 0)
+		return status;
+
+	printf("scheme quantum cores      jobs      events   end_time   seconds  Mevents/sec  peak_rss_mb status paths\n");
+	fflush(stdout);
+
+	for (i = 0; i < scheme_count; i++)
+	{
+		for (j = 0; j < core_count; j++)
+		{
+			throughput_run_t run;
+
+			run.scheme = scheme_list[i];
+			run.quantum = !scheme_has_quantum(run.scheme) ? 0 : (scheme_quanta[i] ? scheme_quanta[i] : quantum);
+			run.cores = core_list[j];
+			run.batched = batched;
+
+			pid_t child = fork();
+			if (child == 0)
+				exit(run_child(&run, jobs, job_count, run_queues));
+
+			int child_status;
+			if (child == -1)
+			{
+				fprintf(stderr, "Unable to start a run; making it here instead.\n");
+				child_status = run_child(&run, jobs, job_count, run_queues);
+			}
+			else if (waitpid(child, &child_status, 0) == -1 || !WIFEXITED(child_status))
+				child_status = 3;
+			else
+				child_status = WEXITSTATUS(child_status);
+
+			if (child_status != 0)
+				status = 3;
+		}
+	}
+
+	free(position);
+	free(jobs);
+	free(core_list);
+	free(scheme_list);
+	free(scheme_quanta);
+
+	return status;
+}
@@ -0,0 +1,319 @@
+/** @file tracegen.c
+ *
+ * Writes a synthetic job file, as CSV in the proc*.csv format or as a
+ * binary trace, for benchmarking with more jobs than the examples have.
+ * Arrivals follow one of:
+ *
+ *   poisson  exponential gaps between arrivals
+ *   bursty   runs of about BURST_LENGTH jobs close together, with long
+ *            quiet gaps between the runs
+ *   pareto   heavy-tailed (Pareto) gaps between arrivals
+ *
+ * and run times are exponential or, with -r pareto, heavy-tailed.  Every
+ * distribution keeps the mean it is given.  The numbers come from a seeded
+ * generator of its own, so the same options give the same file anywhere.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "libsimulator/libsimulator.h"
+
+
+#define BURST_LENGTH 50
+#define PARETO_SHAPE 1.5
+#define SAMPLE_LIMIT (1 << 20)  // keeps each gap and run time well inside an int
+
+enum { POISSON = 0, BURSTY, PARETO };  // arrivals
+enum { EXPONENTIAL = 0, HEAVY_TAILED };  // run times
+
+typedef struct _tracegen_t
+{
+	long job_count;
+	int arrivals, run_times;
+	double mean_gap, mean_run;
+	int priorities;
+	double slack;  // 0 for no deadlines
+	int binary;
+
+	uint64_t state;
+} tracegen_t;
+
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-n <jobs>] [-a <arrivals>] [-i <mean gap>] [-r <run times>] [-t <mean run time>]\n", program_name);
+	fprintf(stderr, "       [-p <priorities>] [-d <slack>] [-x <seed>] [-b] <output file>\n");
+	fprintf(stderr, "       %s -n 1000000 -a bursty -r pareto big.csv\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -n  number of jobs (default: 100000)\n");
+	fprintf(stderr, "  -a  arrivals: poisson, bursty or pareto (default: poisson)\n");
+	fprintf(stderr, "  -i  mean time between arrivals (default: 10)\n");
+	fprintf(stderr, "  -r  run times: exponential or pareto (default: exponential)\n");
+	fprintf(stderr, "  -t  mean run time (default: 8)\n");
+	fprintf(stderr, "  -p  priorities are drawn from 0 up to this, exclusive (default: 8)\n");
+	fprintf(stderr, "  -d  give every job a deadline of its arrival plus its run time\n");
+	fprintf(stderr, "      times 1 to 1 + slack\n");
+	fprintf(stderr, "  -x  seed (default: 1)\n");
+	fprintf(stderr, "  -b  write a binary trace instead of CSV\n");
+}
+
+// splitmix64, so the output does not depend on the C library's rand().
+uint64_t next_random(tracegen_t *gen)
+{
+	uint64_t z = (gen->state += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// Uniform in (0, 1].
+double next_uniform(tracegen_t *gen)
+{
+	return ((next_random(gen) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+double next_exponential(tracegen_t *gen, double mean)
+{
+	return -mean * log(next_uniform(gen));
+}
+
+double next_pareto(tracegen_t *gen, double mean)
+{
+	double scale = mean * (PARETO_SHAPE - 1) / PARETO_SHAPE;
+
+	return scale / pow(next_uniform(gen), 1 / PARETO_SHAPE);
+}
+
+int clamp_sample(double sample, int least)
+{
+	if (sample > SAMPLE_LIMIT)
+		return SAMPLE_LIMIT;
+	return (sample < least) ? least : (int)(sample + 0.5);
+}
+
+int next_gap(tracegen_t *gen)
+{
+	double gap;
+
+	switch (gen->arrivals)
+	{
+		case BURSTY:
+			// A tenth of the mean inside a burst; the rest comes back in the gap after it.
+			gap = next_exponential(gen, gen->mean_gap / 10);
+			if (next_random(gen) % BURST_LENGTH == 0)
+				gap += next_exponential(gen, gen->mean_gap * 0.9 * BURST_LENGTH);
+			break;
+
+		case PARETO:
+			gap = next_pareto(gen, gen->mean_gap);
+			break;
+
+		default:
+			gap = next_exponential(gen, gen->mean_gap);
+			break;
+	}
+
+	return clamp_sample(gap, 0);
+}
+
+int next_run_time(tracegen_t *gen)
+{
+	double run_time = (gen->run_times == HEAVY_TAILED) ? next_pareto(gen, gen->mean_run) : next_exponential(gen, gen->mean_run);
+
+	return clamp_sample(run_time, 1);
+}
+
+int write_jobs(tracegen_t *gen, FILE *out)
+{
+	trace_header_t header;
+	int32_t *deadlines = NULL;
+	int64_t total_time = 0;  // the arrival time, before it is known to fit
+	long i;
+
+	if (gen->binary)
+	{
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, TRACE_MAGIC, 8);
+		header.version = TRACE_VERSION;
+		header.flags = (gen->slack > 0) ? TRACE_DEADLINES : 0;
+		header.job_count = gen->job_count;
+		fwrite(&header, sizeof(header), 1, out);
+
+		if (gen->slack > 0 && (deadlines = malloc(gen->job_count * sizeof(int32_t))) == NULL)
+		{
+			fprintf(stderr, "Out of memory.\n");
+			return 2;
+		}
+	}
+	else if (gen->slack > 0)
+		fprintf(out, "\"Arrival time\",\"Run time\",\"Priority\",\"Deadline\"\n");
+	else
+		fprintf(out, "\"Arrival time\",\"Run time\",\"Priority\"\n");
+
+	for (i = 0; i < gen->job_count; i++)
+	{
+		if (i > 0)
+			total_time += next_gap(gen);
+
+		// Leave room after the arrival for the job's run time or deadline.
+		if (total_time > INT32_MAX - SAMPLE_LIMIT)
+		{
+			fprintf(stderr, "Arrival times pass %d after %ld jobs; use fewer jobs or a shorter mean gap.\n",
+			        INT32_MAX - SAMPLE_LIMIT, i);
+			free(deadlines);
+			return 1;
+		}
+
+		int arrival_time = total_time;
+		int run_time = next_run_time(gen);
+		int priority = next_random(gen) % gen->priorities;
+		int deadline = -1;
+
+		if (gen->slack > 0)
+			deadline = arrival_time + clamp_sample(run_time * (1 + gen->slack * next_uniform(gen)), run_time);
+
+		if (gen->binary)
+		{
+			trace_record_t record;
+
+			record.arrival_time = arrival_time;
+			record.run_time = run_time;
+			record.priority = priority;
+			fwrite(&record, sizeof(record), 1, out);
+
+			if (deadlines != NULL)
+				deadlines[i] = deadline;
+		}
+		else if (gen->slack > 0)
+			fprintf(out, "%d,%d,%d,%d\n", arrival_time, run_time, priority, deadline);
+		else
+			fprintf(out, "%d,%d,%d\n", arrival_time, run_time, priority);
+	}
+
+	if (deadlines != NULL)
+	{
+		fwrite(deadlines, sizeof(int32_t), gen->job_count, out);
+		free(deadlines);
+	}
+
+	return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	int c;
+	tracegen_t gen;
+
+	gen.job_count = 100000;
+	gen.arrivals = POISSON;
+	gen.run_times = EXPONENTIAL;
+	gen.mean_gap = 10;
+	gen.mean_run = 8;
+	gen.priorities = 8;
+	gen.slack = 0;
+	gen.binary = 0;
+	gen.state = 1;
+
+	while ((c = getopt(argc, argv, "n:a:i:r:t:p:d:x:b")) != -1)
+	{
+		switch (c)
+		{
+			case 'n':
+				gen.job_count = atol(optarg);
+				break;
+
+			case 'a':
+				if (strcasecmp(optarg, "poisson") == 0) { gen.arrivals = POISSON; }
+				else if (strcasecmp(optarg, "bursty") == 0) { gen.arrivals = BURSTY; }
+				else if (strcasecmp(optarg, "pareto") == 0) { gen.arrivals = PARETO; }
+				else
+				{
+					fprintf(stderr, "Option -a <arrivals> takes poisson, bursty or pareto.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 'i':
+				gen.mean_gap = atof(optarg);
+				break;
+
+			case 'r':
+				if (strcasecmp(optarg, "exponential") == 0) { gen.run_times = EXPONENTIAL; }
+				else if (strcasecmp(optarg, "pareto") == 0) { gen.run_times = HEAVY_TAILED; }
+				else
+				{
+					fprintf(stderr, "Option -r <run times> takes exponential or pareto.\n");
+					print_usage(argv[0]);
+					return 1;
+				}
+				break;
+
+			case 't':
+				gen.mean_run = atof(optarg);
+				break;
+
+			case 'p':
+				gen.priorities = atoi(optarg);
+				break;
+
+			case 'd':
+				gen.slack = atof(optarg);
+				break;
+
+			case 'x':
+				gen.state = strtoull(optarg, NULL, 10);
+				break;
+
+			case 'b':
+				gen.binary = 1;
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (gen.job_count <= 0 || gen.job_count > INT32_MAX || gen.mean_gap < 0 || gen.mean_run < 1 || gen.priorities <= 0 || gen.slack < 0)
+	{
+		fprintf(stderr, "Options -n, -t and -p require positive numbers, and -i and -d numbers of at least 0.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (optind != argc - 1)
+	{
+		fprintf(stderr, "A single output file is required.\n");
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	FILE *out = fopen(argv[optind], gen.binary ? "wb" : "w");
+	if (out == NULL)
+	{
+		fprintf(stderr, "Unable to open file \"%s\".\n", argv[optind]);
+		return 2;
+	}
+
+	int status = write_jobs(&gen, out);
+
+	if (fclose(out) != 0 && status == 0)
+	{
+		fprintf(stderr, "Unable to write file \"%s\".\n", argv[optind]);
+		status = 2;
+	}
+
+	// Don't leave a partial file behind to be mistaken for a whole one.
+	if (status != 0)
+		remove(argv[optind]);
+
+	return status;
+}